@@ -0,0 +1,340 @@
+#include "AsyncLog.h"
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <functional>
+
+namespace chip8
+{
+
+namespace
+{
+    // Releases the calling thread's ring for reuse when the thread exits
+    struct RingOwner
+    {
+        void* ring;
+        std::atomic<bool>* inUse;
+
+        RingOwner() : ring(NULL), inUse(NULL) {}
+        ~RingOwner()
+        {
+            if (inUse != NULL)
+            {
+                inUse->store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    thread_local RingOwner  t_owner;
+    thread_local uint8_t    t_threadId = 0;
+    thread_local bool       t_hasThreadId = false;
+}
+
+AsyncLog::AsyncLog()
+: _drainRun(true)
+, _drainPasses(0)
+, _drainThread(NULL)
+{
+    _drainThread = new std::thread(&AsyncLog::DrainThread, this);
+}
+
+AsyncLog::~AsyncLog()
+{
+    _drainRun = false;
+    _drainThread->join();
+    delete _drainThread;
+    Drain();
+    fflush(stderr);
+    // Rings are intentionally leaked; threads may still hold pointers to them
+}
+
+AsyncLog& AsyncLog::Instance()
+{
+    static AsyncLog instance;
+    return instance;
+}
+
+void AsyncLog::Flush()
+{
+    AsyncLog& log = Instance();
+    uint64_t pass = log._drainPasses.load();
+    // Two full passes guarantee every record committed before this call was printed
+    while (log._drainPasses.load() < pass + 2)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    fflush(stderr);
+}
+
+AsyncLog::Ring* AsyncLog::GetRing()
+{
+    if (t_owner.ring != NULL)
+    {
+        return (Ring*)t_owner.ring;
+    }
+
+    std::lock_guard<std::mutex> lock(_ringLock);
+    Ring* ring = NULL;
+    for (size_t i = 0; i < _rings.size(); i++)
+    {
+        Ring* candidate = _rings[i];
+        if (!candidate->inUse.load(std::memory_order_acquire) &&
+            (candidate->head.load() == candidate->tail.load()))
+        {
+            ring = candidate;
+            break;
+        }
+    }
+
+    if (ring == NULL)
+    {
+        ring = new Ring();
+        ring->head = 0;
+        ring->tail = 0;
+        ring->dropped = 0;
+        _rings.push_back(ring);
+    }
+    ring->inUse = true;
+    t_owner.ring = ring;
+    t_owner.inUse = &ring->inUse;
+    return ring;
+}
+
+AsyncLog::Record* AsyncLog::Acquire()
+{
+    Ring* ring = GetRing();
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    if ((head - ring->tail.load(std::memory_order_acquire)) >= RING_SIZE)
+    {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return NULL;
+    }
+
+    if (!t_hasThreadId)
+    {
+        std::hash<std::thread::id> idHash;
+        t_threadId = (uint8_t)idHash(std::this_thread::get_id());
+        t_hasThreadId = true;
+    }
+
+    Record* record = &ring->records[head & (RING_SIZE - 1)];
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    record->timeNs = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    record->threadId = t_threadId;
+    return record;
+}
+
+void AsyncLog::Commit()
+{
+    Ring* ring = (Ring*)t_owner.ring;
+    ring->head.store(ring->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+bool AsyncLog::Drain()
+{
+    std::vector<Ring*> rings;
+    {
+        std::lock_guard<std::mutex> lock(_ringLock);
+        rings = _rings;
+    }
+
+    bool didWork = false;
+    for (size_t i = 0; i < rings.size(); i++)
+    {
+        Ring* ring = rings[i];
+        uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint32_t head = ring->head.load(std::memory_order_acquire);
+        while (tail != head)
+        {
+            Print(ring->records[tail & (RING_SIZE - 1)]);
+            tail++;
+            ring->tail.store(tail, std::memory_order_release);
+            didWork = true;
+        }
+
+        uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped != 0)
+        {
+            fprintf(stderr, "AsyncLog: %llu records dropped\n", (unsigned long long)dropped);
+        }
+    }
+    _drainPasses.fetch_add(1);
+    return didWork;
+}
+
+void AsyncLog::SetArg(Record& record, Arg& arg, const char* value)
+{
+    // The caller's string may be gone by the time the drain prints it
+    arg.type = ARG_STRING;
+    arg.size = sizeof(value);
+    arg.s = record.stringsUsed;
+    uint32_t room = STRING_BYTES - record.stringsUsed;
+    if (room == 0)
+    {
+        // Point at the previous string's terminator
+        arg.s = STRING_BYTES - 1;
+        return;
+    }
+    if (value == NULL)
+    {
+        value = "(null)";
+    }
+    size_t length = strnlen(value, room - 1);
+    memcpy(record.strings + record.stringsUsed, value, length);
+    record.strings[record.stringsUsed + length] = '\0';
+    record.stringsUsed += length + 1;
+}
+
+void AsyncLog::DrainThread()
+{
+    while (_drainRun)
+    {
+        if (!Drain())
+        {
+            std::chrono::milliseconds period(1);
+            std::this_thread::sleep_for(period);
+        }
+    }
+}
+
+void AsyncLog::Print(const Record& record)
+{
+    char message[512];
+    size_t used = 0;
+    uint8_t argIndex = 0;
+    const char* fmt = record.format;
+
+    while ((*fmt != '\0') && (used < sizeof(message) - 1))
+    {
+        if (*fmt != '%')
+        {
+            message[used++] = *fmt++;
+            continue;
+        }
+
+        // Collect the conversion spec, dropping any length modifiers
+        char spec[32];
+        size_t specLen = 0;
+        spec[specLen++] = *fmt++;
+        while ((*fmt != '\0') && (strchr("-+ #0123456789.", *fmt) != NULL) && (specLen < sizeof(spec) - 4))
+        {
+            spec[specLen++] = *fmt++;
+        }
+        while ((*fmt != '\0') && (strchr("hljztL", *fmt) != NULL))
+        {
+            fmt++;
+        }
+        char conversion = *fmt;
+        if (conversion == '\0')
+        {
+            break;
+        }
+        fmt++;
+
+        int written = 0;
+        size_t room = sizeof(message) - used;
+        if (conversion == '%')
+        {
+            message[used++] = '%';
+            continue;
+        }
+        if (argIndex >= record.argCount)
+        {
+            written = snprintf(message + used, room, "<?>");
+        }
+        else
+        {
+            const Arg& arg = record.args[argIndex++];
+            switch (conversion)
+            {
+                case 'd':
+                case 'i':
+                case 'c':
+                {
+                    if (conversion != 'c')
+                    {
+                        spec[specLen++] = 'l';
+                        spec[specLen++] = 'l';
+                    }
+                    spec[specLen++] = conversion;
+                    spec[specLen] = '\0';
+                    if (conversion == 'c')
+                    {
+                        written = snprintf(message + used, room, spec, (int)arg.i);
+                    }
+                    else
+                    {
+                        written = snprintf(message + used, room, spec, (long long)arg.i);
+                    }
+                }
+                break;
+
+                case 'u':
+                case 'x':
+                case 'X':
+                case 'o':
+                {
+                    uint64_t value = arg.u;
+                    if (arg.size < sizeof(uint64_t))
+                    {
+                        value &= ((1ULL << (8 * arg.size)) - 1);
+                    }
+                    spec[specLen++] = 'l';
+                    spec[specLen++] = 'l';
+                    spec[specLen++] = conversion;
+                    spec[specLen] = '\0';
+                    written = snprintf(message + used, room, spec, (unsigned long long)value);
+                }
+                break;
+
+                case 'f':
+                case 'F':
+                case 'e':
+                case 'E':
+                case 'g':
+                case 'G':
+                {
+                    spec[specLen++] = conversion;
+                    spec[specLen] = '\0';
+                    written = snprintf(message + used, room, spec, arg.d);
+                }
+                break;
+
+                case 's':
+                {
+                    spec[specLen++] = conversion;
+                    spec[specLen] = '\0';
+                    written = snprintf(message + used, room, spec,
+                                       (arg.type == ARG_STRING) ? (record.strings + arg.s) : "<?>");
+                }
+                break;
+
+                default:
+                {
+                    written = snprintf(message + used, room, "%p", arg.p);
+                }
+                break;
+            }
+        }
+
+        if (written > 0)
+        {
+            used += ((size_t)written < room) ? (size_t)written : room - 1;
+        }
+    }
+    message[used] = '\0';
+
+    time_t seconds = (time_t)(record.timeNs / 1000000000ULL);
+    int milli = (int)((record.timeNs / 1000000ULL) % 1000);
+    tm localTime;
+    localtime_r(&seconds, &localTime);
+    char buffer[80];
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &localTime);
+
+    fprintf(stderr, "%s%s.%d (%03d) - %s: %s\n%s",
+            record.isRed ? "\033[0;31m" : "",
+            buffer, milli, record.threadId, record.tag, message,
+            record.isRed ? "\033[0m" : "");
+}
+} /* namespace chip8 */
@@ -0,0 +1,176 @@
+#ifndef ASYNCLOG_H_
+#define ASYNCLOG_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <type_traits>
+
+namespace chip8
+{
+    /**
+     * Background logger used when tracing is compiled in.  Callers copy
+     * the format pointer and raw arguments into a lock-free ring buffer
+     * owned by their thread; a drain thread does the formatting and the
+     * writes to stderr.
+     *
+     * Format strings are stored by pointer, so they must outlive the drain
+     * (string literals).  %s arguments are copied into the record, and cut
+     * short once a record's STRING_BYTES are used up.
+     */
+    class AsyncLog
+    {
+    public:
+        static const uint8_t  MAX_ARGS     = 8;
+        static const uint32_t RING_SIZE    = 4096;  // Records per thread, power of two
+        static const uint32_t STRING_BYTES = 128;   // Copied %s text per record
+
+        enum ArgType
+        {
+            ARG_SIGNED      = 0,
+            ARG_UNSIGNED    = 1,
+            ARG_DOUBLE      = 2,
+            ARG_STRING      = 3,
+            ARG_POINTER     = 4
+        };
+
+        struct Arg
+        {
+            uint8_t type;
+            uint8_t size;
+            union
+            {
+                int64_t     i;
+                uint64_t    u;
+                double      d;
+                uint32_t    s;          // Offset into Record::strings
+                const void* p;
+            };
+        };
+
+        struct Record
+        {
+            uint64_t    timeNs;
+            const char* tag;
+            const char* format;
+            uint8_t     isRed;
+            uint8_t     threadId;
+            uint8_t     argCount;
+            uint32_t    stringsUsed;
+            Arg         args[MAX_ARGS];
+            char        strings[STRING_BYTES];
+        };
+
+        /**
+         * Queues a log record on the calling thread's ring buffer.  Never
+         * blocks; the record is dropped (and counted) if the ring is full.
+         * @param isRed True to print the record in red
+         * @param tag The LOG_TAG of the caller
+         * @param format A printf style format string
+         */
+        template <typename... Args>
+        static void Write(bool isRed, const char* tag, const char* format, Args... args)
+        {
+            Record* record = Instance().Acquire();
+            if (record == NULL)
+            {
+                return;
+            }
+            record->isRed = isRed;
+            record->tag = tag;
+            record->format = format;
+            record->argCount = 0;
+            record->stringsUsed = 0;
+            Capture(*record, args...);
+            Instance().Commit();
+        }
+
+        /**
+         * Blocks until every record queued so far has been written
+         */
+        static void Flush();
+
+    protected:
+        struct Ring
+        {
+            std::atomic<uint32_t>   head;       // Next slot the owner writes
+            std::atomic<uint32_t>   tail;       // Next slot the drain reads
+            std::atomic<uint64_t>   dropped;
+            std::atomic<bool>       inUse;
+            Record                  records[RING_SIZE];
+        };
+
+        AsyncLog();
+        ~AsyncLog();
+
+        static AsyncLog& Instance();
+
+        Record* Acquire();
+        void Commit();
+        Ring* GetRing();
+        bool Drain();
+        void DrainThread();
+        void Print(const Record& record);
+
+        static void Capture(Record&) {}
+
+        template <typename T, typename... Rest>
+        static void Capture(Record& record, T value, Rest... rest)
+        {
+            if (record.argCount < MAX_ARGS)
+            {
+                Arg& arg = record.args[record.argCount++];
+                SetArg(record, arg, value);
+            }
+            Capture(record, rest...);
+        }
+
+        template <typename T>
+        static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+        SetArg(Record&, Arg& arg, T value)
+        {
+            // Match the default argument promotions printf would have seen
+            arg.size = (sizeof(T) < sizeof(int)) ? sizeof(int) : sizeof(T);
+            if (std::is_signed<T>::value)
+            {
+                arg.type = ARG_SIGNED;
+                arg.i = (int64_t)value;
+            }
+            else
+            {
+                arg.type = ARG_UNSIGNED;
+                arg.u = (uint64_t)value;
+            }
+        }
+
+        template <typename T>
+        static typename std::enable_if<std::is_floating_point<T>::value>::type
+        SetArg(Record&, Arg& arg, T value)
+        {
+            arg.type = ARG_DOUBLE;
+            arg.size = sizeof(double);
+            arg.d = value;
+        }
+
+        static void SetArg(Record& record, Arg& arg, const char* value);
+
+        static void SetArg(Record&, Arg& arg, const void* value)
+        {
+            arg.type = ARG_POINTER;
+            arg.size = sizeof(value);
+            arg.p = value;
+        }
+
+        std::mutex          _ringLock;
+        std::vector<Ring*>  _rings;
+        std::atomic<bool>   _drainRun;
+        std::atomic<uint64_t> _drainPasses;
+        std::thread*        _drainThread;
+    };
+
+} /* namespace chip8 */
+
+#endif /* ASYNCLOG_H_ */
@@ -0,0 +1,956 @@
+#include "BatchEngine.h"
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_X86 1
+#endif
+
+#define LOG_TAG "BatchEngine"
+#include "log.h"
+
+namespace chip8
+{
+
+namespace
+{
+    enum AluOp
+    {
+        ALU_SET_IMM,
+        ALU_ADD_IMM,
+        ALU_MOV,
+        ALU_OR,
+        ALU_AND,
+        ALU_XOR,
+        ALU_ADD,
+        ALU_SUB,
+        ALU_SUBN,
+        ALU_SHR,
+        ALU_SHL
+    };
+
+    enum IndexOp
+    {
+        INDEX_SET,
+        INDEX_ADD,
+        INDEX_CHAR
+    };
+
+    const uint8_t fontData[] =
+    {
+            0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+            0x20, 0x60, 0x20, 0x20, 0x70, // 1
+            0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+            0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+            0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+            0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+            0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+            0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+            0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+            0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+            0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+            0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+            0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+            0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+            0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+            0xF0, 0x80, 0xF0, 0x80, 0x80 // F
+    };
+
+    // Generic lane loops, used when no SIMD kernel is available.  Each op
+    // follows the statement order of Chip8Processor::Math so VF aliasing
+    // behaves identically.
+    void AluScalar(AluOp op, uint8_t* vx, uint8_t* vy, uint8_t* vf, uint8_t imm, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            switch (op)
+            {
+                case ALU_SET_IMM:   vx[i] = imm; break;
+                case ALU_ADD_IMM:   vx[i] += imm; break;
+                case ALU_MOV:       vx[i] = vy[i]; break;
+                case ALU_OR:        vx[i] |= vy[i]; break;
+                case ALU_AND:       vx[i] &= vy[i]; break;
+                case ALU_XOR:       vx[i] ^= vy[i]; break;
+                case ALU_ADD:
+                {
+                    uint8_t oldX = vx[i];
+                    vx[i] += vy[i];
+                    vf[i] = (vx[i] < oldX);
+                }
+                break;
+                case ALU_SUB:
+                {
+                    vf[i] = (vx[i] > vy[i]) ? 1 : 0;
+                    vx[i] = vx[i] - vy[i];
+                }
+                break;
+                case ALU_SUBN:
+                {
+                    vf[i] = (vy[i] > vx[i]) ? 1 : 0;
+                    vx[i] = vy[i] - vx[i];
+                }
+                break;
+                case ALU_SHR:
+                {
+                    vf[i] = vx[i] & 0x01;
+                    vx[i] >>= 1;
+                }
+                break;
+                case ALU_SHL:
+                {
+                    vf[i] = (vx[i] & 0x80) == 0 ? 0 : 1;
+                    vx[i] <<= 1;
+                }
+                break;
+            }
+        }
+    }
+
+#ifndef BATCH_X86
+    void IndexScalar(IndexOp op, uint16_t* I, const uint8_t* vx, uint16_t imm, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            switch (op)
+            {
+                case INDEX_SET:     I[i] = imm; break;
+                case INDEX_ADD:     I[i] += vx[i]; break;
+                case INDEX_CHAR:    I[i] = 5 * vx[i]; break;
+            }
+        }
+    }
+
+    void SkipScalar(uint16_t* pc, const uint8_t* vx, const uint8_t* vy, uint8_t imm,
+                    bool compareImm, bool ifEqual, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            bool isEqual = (vx[i] == (compareImm ? imm : vy[i]));
+            pc[i] += (isEqual == ifEqual) ? 4 : 2;
+        }
+    }
+#endif
+
+#ifdef BATCH_X86
+    /*
+     * The byte-lane ALU kernel is the same for SSE2 and AVX2 apart from the
+     * vector type and intrinsic names.  Unsigned a > b is computed as
+     * max(a, b) != b since neither ISA has an unsigned byte compare.
+     */
+    #define BATCH_ALU_KERNEL(NAME, ATTR, VEC, WIDTH, LOAD, STORE, SET1, ADD, SUB, \
+                             OR, AND, XOR, ANDNOT, MAX, CMPEQ, SRLI16) \
+    ATTR void NAME(AluOp op, uint8_t* vx, uint8_t* vy, uint8_t* vf, uint8_t imm, uint32_t count) \
+    { \
+        const VEC one = SET1(1); \
+        const VEC immV = SET1((char)imm); \
+        for (uint32_t i = 0; i < count; i += WIDTH) \
+        { \
+            VEC a = LOAD((const VEC*)(vx + i)); \
+            VEC b = LOAD((const VEC*)(vy + i)); \
+            switch (op) \
+            { \
+                case ALU_SET_IMM:   STORE((VEC*)(vx + i), immV); break; \
+                case ALU_ADD_IMM:   STORE((VEC*)(vx + i), ADD(a, immV)); break; \
+                case ALU_MOV:       STORE((VEC*)(vx + i), b); break; \
+                case ALU_OR:        STORE((VEC*)(vx + i), OR(a, b)); break; \
+                case ALU_AND:       STORE((VEC*)(vx + i), AND(a, b)); break; \
+                case ALU_XOR:       STORE((VEC*)(vx + i), XOR(a, b)); break; \
+                case ALU_ADD: \
+                { \
+                    VEC sum = ADD(a, b); \
+                    STORE((VEC*)(vx + i), sum); \
+                    sum = LOAD((const VEC*)(vx + i)); \
+                    VEC noCarry = CMPEQ(MAX(sum, a), sum); \
+                    STORE((VEC*)(vf + i), ANDNOT(noCarry, one)); \
+                } \
+                break; \
+                case ALU_SUB: \
+                case ALU_SUBN: \
+                { \
+                    uint8_t* pa = (op == ALU_SUB) ? vx : vy; \
+                    uint8_t* pb = (op == ALU_SUB) ? vy : vx; \
+                    a = LOAD((const VEC*)(pa + i)); \
+                    b = LOAD((const VEC*)(pb + i)); \
+                    VEC notGreater = CMPEQ(MAX(a, b), b); \
+                    STORE((VEC*)(vf + i), ANDNOT(notGreater, one)); \
+                    a = LOAD((const VEC*)(pa + i)); \
+                    b = LOAD((const VEC*)(pb + i)); \
+                    STORE((VEC*)(vx + i), SUB(a, b)); \
+                } \
+                break; \
+                case ALU_SHR: \
+                { \
+                    STORE((VEC*)(vf + i), AND(a, one)); \
+                    a = LOAD((const VEC*)(vx + i)); \
+                    STORE((VEC*)(vx + i), AND(SRLI16(a, 1), SET1(0x7F))); \
+                } \
+                break; \
+                case ALU_SHL: \
+                { \
+                    STORE((VEC*)(vf + i), AND(SRLI16(a, 7), one)); \
+                    a = LOAD((const VEC*)(vx + i)); \
+                    STORE((VEC*)(vx + i), ADD(a, a)); \
+                } \
+                break; \
+            } \
+        } \
+    }
+
+    BATCH_ALU_KERNEL(AluSse2, , __m128i, 16, _mm_loadu_si128, _mm_storeu_si128, _mm_set1_epi8,
+                     _mm_add_epi8, _mm_sub_epi8, _mm_or_si128, _mm_and_si128, _mm_xor_si128,
+                     _mm_andnot_si128, _mm_max_epu8, _mm_cmpeq_epi8, _mm_srli_epi16)
+
+    BATCH_ALU_KERNEL(AluAvx2, __attribute__((target("avx2"))), __m256i, 32, _mm256_loadu_si256,
+                     _mm256_storeu_si256, _mm256_set1_epi8, _mm256_add_epi8, _mm256_sub_epi8,
+                     _mm256_or_si256, _mm256_and_si256, _mm256_xor_si256, _mm256_andnot_si256,
+                     _mm256_max_epu8, _mm256_cmpeq_epi8, _mm256_srli_epi16)
+
+    #undef BATCH_ALU_KERNEL
+
+    void IndexSse2(IndexOp op, uint16_t* I, const uint8_t* vx, uint16_t imm, uint32_t count)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i immV = _mm_set1_epi16((short)imm);
+        const __m128i five = _mm_set1_epi16(5);
+        for (uint32_t i = 0; i < count; i += 8)
+        {
+            __m128i x = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(vx + i)), zero);
+            __m128i* dst = (__m128i*)(I + i);
+            switch (op)
+            {
+                case INDEX_SET:     _mm_storeu_si128(dst, immV); break;
+                case INDEX_ADD:     _mm_storeu_si128(dst, _mm_add_epi16(_mm_loadu_si128(dst), x)); break;
+                case INDEX_CHAR:    _mm_storeu_si128(dst, _mm_mullo_epi16(x, five)); break;
+            }
+        }
+    }
+
+    __attribute__((target("avx2")))
+    void IndexAvx2(IndexOp op, uint16_t* I, const uint8_t* vx, uint16_t imm, uint32_t count)
+    {
+        const __m256i immV = _mm256_set1_epi16((short)imm);
+        const __m256i five = _mm256_set1_epi16(5);
+        for (uint32_t i = 0; i < count; i += 16)
+        {
+            __m256i x = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(vx + i)));
+            __m256i* dst = (__m256i*)(I + i);
+            switch (op)
+            {
+                case INDEX_SET:     _mm256_storeu_si256(dst, immV); break;
+                case INDEX_ADD:     _mm256_storeu_si256(dst, _mm256_add_epi16(_mm256_loadu_si256(dst), x)); break;
+                case INDEX_CHAR:    _mm256_storeu_si256(dst, _mm256_mullo_epi16(x, five)); break;
+            }
+        }
+    }
+
+    void SkipSse2(uint16_t* pc, const uint8_t* vx, const uint8_t* vy, uint8_t imm,
+                  bool compareImm, bool ifEqual, uint32_t count)
+    {
+        // pc += ifEqual ? 2 + (eq & 2) : 4 - (eq & 2)
+        const __m128i immV = _mm_set1_epi8((char)imm);
+        const __m128i two = _mm_set1_epi16(2);
+        const __m128i base = _mm_set1_epi16(ifEqual ? 2 : 4);
+        for (uint32_t i = 0; i < count; i += 8)
+        {
+            __m128i x = _mm_loadl_epi64((const __m128i*)(vx + i));
+            __m128i y = compareImm ? immV : _mm_loadl_epi64((const __m128i*)(vy + i));
+            __m128i eq = _mm_cmpeq_epi8(x, y);
+            __m128i step = _mm_and_si128(_mm_unpacklo_epi8(eq, eq), two);
+            step = ifEqual ? _mm_add_epi16(base, step) : _mm_sub_epi16(base, step);
+            __m128i* dst = (__m128i*)(pc + i);
+            _mm_storeu_si128(dst, _mm_add_epi16(_mm_loadu_si128(dst), step));
+        }
+    }
+
+    __attribute__((target("avx2")))
+    void SkipAvx2(uint16_t* pc, const uint8_t* vx, const uint8_t* vy, uint8_t imm,
+                  bool compareImm, bool ifEqual, uint32_t count)
+    {
+        const __m128i immV = _mm_set1_epi8((char)imm);
+        const __m256i two = _mm256_set1_epi16(2);
+        const __m256i base = _mm256_set1_epi16(ifEqual ? 2 : 4);
+        for (uint32_t i = 0; i < count; i += 16)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i*)(vx + i));
+            __m128i y = compareImm ? immV : _mm_loadu_si128((const __m128i*)(vy + i));
+            __m256i eq = _mm256_cvtepi8_epi16(_mm_cmpeq_epi8(x, y));
+            __m256i step = _mm256_and_si256(eq, two);
+            step = ifEqual ? _mm256_add_epi16(base, step) : _mm256_sub_epi16(base, step);
+            __m256i* dst = (__m256i*)(pc + i);
+            _mm256_storeu_si256(dst, _mm256_add_epi16(_mm256_loadu_si256(dst), step));
+        }
+    }
+#endif
+}
+
+const uint16_t BatchEngine::ROM_OFFSET;
+const uint16_t BatchEngine::STACK_OFFSET;
+
+struct BatchEngine::Kernels
+{
+    const char* name;
+    void (*alu)(AluOp op, uint8_t* vx, uint8_t* vy, uint8_t* vf, uint8_t imm, uint32_t count);
+    void (*index)(IndexOp op, uint16_t* I, const uint8_t* vx, uint16_t imm, uint32_t count);
+    void (*skip)(uint16_t* pc, const uint8_t* vx, const uint8_t* vy, uint8_t imm,
+                 bool compareImm, bool ifEqual, uint32_t count);
+};
+
+double BatchEngine::Stats::InstructionsPerSecond() const
+{
+    return (seconds > 0) ? (instructions / seconds) : 0;
+}
+
+BatchEngine::BatchEngine(uint32_t laneCount)
+: _laneCount(laneCount)
+, _paddedCount(((laneCount + LANE_ALIGN - 1) / LANE_ALIGN) * LANE_ALIGN)
+, _runningLanes(0)
+, _converged(false)
+, _ramDiverged(false)
+, _instructions(0)
+, _vectorSteps(0)
+, _scalarSteps(0)
+, _kernels(SelectKernels())
+{
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        _v[i].resize(_paddedCount);
+    }
+    _pc.resize(_paddedCount);
+    _I.resize(_paddedCount);
+    _sp.resize(_paddedCount);
+    _delayTimer.resize(_paddedCount);
+    _soundTimer.resize(_paddedCount);
+    _keys.resize(_paddedCount);
+    _rng.resize(_paddedCount);
+    _halted.resize(_paddedCount);
+    _ram.resize((size_t)_paddedCount * RAM_SIZE);
+    _frames.resize((size_t)_paddedCount * DISP_HEIGHT);
+
+    for (uint32_t lane = 0; lane < _paddedCount; lane++)
+    {
+        memcpy(Ram(lane), fontData, sizeof(fontData));
+    }
+    SetSeed(1);
+    Reset();
+    LOG("%u lanes using %s kernels", laneCount, _kernels->name);
+}
+
+BatchEngine::~BatchEngine()
+{
+}
+
+uint8_t* BatchEngine::Ram(uint32_t lane)
+{
+    return &_ram[(size_t)lane * RAM_SIZE];
+}
+
+bool BatchEngine::LoadRom(const uint8_t* src, uint16_t length)
+{
+    if (length > (RAM_SIZE - ROM_OFFSET))
+    {
+        LOG_ERROR("Length is too long: %d", length);
+        return false;
+    }
+
+    for (uint32_t lane = 0; lane < _paddedCount; lane++)
+    {
+        memcpy(Ram(lane) + ROM_OFFSET, src, length);
+    }
+    _ramDiverged = false;
+    return true;
+}
+
+void BatchEngine::Reset()
+{
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        std::fill(_v[i].begin(), _v[i].end(), 0);
+    }
+    std::fill(_pc.begin(), _pc.end(), ROM_OFFSET);
+    std::fill(_I.begin(), _I.end(), 0);
+    std::fill(_sp.begin(), _sp.end(), STACK_OFFSET);
+    std::fill(_delayTimer.begin(), _delayTimer.end(), 0);
+    std::fill(_soundTimer.begin(), _soundTimer.end(), 0);
+    std::fill(_frames.begin(), _frames.end(), 0);
+
+    // Padding lanes are permanently halted
+    for (uint32_t lane = 0; lane < _paddedCount; lane++)
+    {
+        _halted[lane] = (lane >= _laneCount);
+    }
+    _haltedLanes.clear();
+    _haltedStates.clear();
+    _runningLanes = _laneCount;
+    _converged = true;
+}
+
+void BatchEngine::SetSeed(uint32_t seed)
+{
+    for (uint32_t lane = 0; lane < _paddedCount; lane++)
+    {
+        // xorshift32 must not start at zero
+        _rng[lane] = (seed + lane) ? (seed + lane) : 0x9E3779B9;
+    }
+}
+
+void BatchEngine::SetKeys(uint32_t lane, uint16_t keyMask)
+{
+    if (lane < _laneCount)
+    {
+        _keys[lane] = keyMask;
+    }
+}
+
+uint32_t BatchEngine::GetLaneCount() const
+{
+    return _laneCount;
+}
+
+bool BatchEngine::IsHalted(uint32_t lane) const
+{
+    return _halted[lane] != 0;
+}
+
+uint8_t BatchEngine::GetRegister(uint32_t lane, uint8_t reg) const
+{
+    return _v[reg & 0x0F][lane];
+}
+
+uint16_t BatchEngine::GetPC(uint32_t lane) const
+{
+    return _pc[lane];
+}
+
+uint16_t BatchEngine::GetI(uint32_t lane) const
+{
+    return _I[lane];
+}
+
+const uint64_t* BatchEngine::GetFrame(uint32_t lane) const
+{
+    return &_frames[(size_t)lane * DISP_HEIGHT];
+}
+
+const char* BatchEngine::GetKernelName() const
+{
+    return _kernels->name;
+}
+
+BatchEngine::Stats BatchEngine::RunFrames(uint32_t frames, uint16_t instructionsPerFrame)
+{
+    uint64_t startInstructions = _instructions;
+    uint64_t startVector = _vectorSteps;
+    uint64_t startScalar = _scalarSteps;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (uint32_t frame = 0; (frame < frames) && (_runningLanes > 0); frame++)
+    {
+        for (uint16_t i = 0; (i < instructionsPerFrame) && (_runningLanes > 0); i++)
+        {
+            Tick();
+        }
+
+        for (uint32_t lane = 0; lane < _paddedCount; lane++)
+        {
+            _delayTimer[lane] -= (_delayTimer[lane] != 0) & !_halted[lane];
+            _soundTimer[lane] -= (_soundTimer[lane] != 0) & !_halted[lane];
+        }
+    }
+
+    Stats stats;
+    stats.instructions = _instructions - startInstructions;
+    stats.vectorSteps = _vectorSteps - startVector;
+    stats.scalarSteps = _scalarSteps - startScalar;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+bool BatchEngine::Tick()
+{
+    uint16_t instruction = 0;
+    if (_converged && CheckConverged(instruction) && StepVector(instruction))
+    {
+        _vectorSteps++;
+        _instructions += _runningLanes;
+        return true;
+    }
+
+    _scalarSteps++;
+    uint16_t firstPc = 0;
+    bool havePc = false;
+    _converged = true;
+    for (uint32_t lane = 0; lane < _laneCount; lane++)
+    {
+        if (_halted[lane])
+        {
+            continue;
+        }
+
+        if (StepLane(lane))
+        {
+            _instructions++;
+        }
+        else
+        {
+            LOG_DEBUG("Lane %u halted at 0x%x", lane, _pc[lane]);
+            _halted[lane] = 1;
+            _haltedLanes.push_back(lane);
+            _haltedStates.resize(_haltedLanes.size());
+            _runningLanes--;
+            continue;
+        }
+
+        if (!havePc)
+        {
+            firstPc = _pc[lane];
+            havePc = true;
+        }
+        else if (_pc[lane] != firstPc)
+        {
+            _converged = false;
+        }
+    }
+    return true;
+}
+
+bool BatchEngine::CheckConverged(uint16_t& instruction)
+{
+    uint32_t first = 0;
+    while ((first < _laneCount) && _halted[first])
+    {
+        first++;
+    }
+    if (first == _laneCount)
+    {
+        return false;
+    }
+
+    uint16_t pc = _pc[first];
+    if (((pc & 1) != 0) || (pc >= RAM_SIZE - 1))
+    {
+        return false;
+    }
+
+    const uint8_t* ram = Ram(first);
+    instruction = (ram[pc] << 8) | ram[pc + 1];
+    if (_ramDiverged)
+    {
+        for (uint32_t lane = first + 1; lane < _laneCount; lane++)
+        {
+            const uint8_t* laneRam = Ram(lane);
+            if (!_halted[lane] && ((laneRam[pc] != ram[pc]) || (laneRam[pc + 1] != ram[pc + 1])))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool BatchEngine::StepVector(uint16_t instruction)
+{
+    uint8_t firstNibble = (instruction >> 12);
+    uint8_t x = (instruction & 0x0F00) >> 8;
+    uint8_t y = (instruction & 0x00F0) >> 4;
+    uint8_t kk = (instruction & 0x00FF);
+    uint16_t nnn = (instruction & 0x0FFF);
+
+    uint32_t first = 0;
+    while (_halted[first])
+    {
+        first++;
+    }
+    uint16_t pc = _pc[first];
+
+    // The kernels run over every lane, so remember what the halted lanes
+    // held in whatever this instruction can write, and put it back after
+    for (size_t i = 0; i < _haltedLanes.size(); i++)
+    {
+        uint32_t lane = _haltedLanes[i];
+        HaltedState state = { _pc[lane], _I[lane], _v[x][lane], _v[15][lane] };
+        _haltedStates[i] = state;
+    }
+
+    bool advance = true;
+    switch (firstNibble)
+    {
+        case 1:
+        {
+            std::fill(_pc.begin(), _pc.end(), nnn);
+            advance = false;
+        }
+        break;
+
+        case 3:
+        case 4:
+        case 5:
+        case 9:
+        {
+            if (((firstNibble == 5) || (firstNibble == 9)) && ((instruction & 0x000F) != 0))
+            {
+                return false;
+            }
+            bool compareImm = (firstNibble == 3) || (firstNibble == 4);
+            bool ifEqual = (firstNibble == 3) || (firstNibble == 5);
+            _kernels->skip(&_pc[0], &_v[x][0], &_v[y][0], kk, compareImm, ifEqual, _paddedCount);
+
+            for (uint32_t lane = first + 1; lane < _laneCount; lane++)
+            {
+                if (!_halted[lane] && (_pc[lane] != _pc[first]))
+                {
+                    _converged = false;
+                    break;
+                }
+            }
+            advance = false;
+        }
+        break;
+
+        case 6:
+        case 7:
+        {
+            _kernels->alu((firstNibble == 6) ? ALU_SET_IMM : ALU_ADD_IMM,
+                          &_v[x][0], &_v[x][0], &_v[15][0], kk, _paddedCount);
+        }
+        break;
+
+        case 8:
+        {
+            AluOp op;
+            switch (instruction & 0x000F)
+            {
+                case 0:  op = ALU_MOV; break;
+                case 1:  op = ALU_OR; break;
+                case 2:  op = ALU_AND; break;
+                case 3:  op = ALU_XOR; break;
+                case 4:  op = ALU_ADD; break;
+                case 5:  op = ALU_SUB; break;
+                case 6:  op = ALU_SHR; break;
+                case 7:  op = ALU_SUBN; break;
+                case 14: op = ALU_SHL; break;
+                default: return false;  // Let the lanes halt one by one
+            }
+            _kernels->alu(op, &_v[x][0], &_v[y][0], &_v[15][0], 0, _paddedCount);
+        }
+        break;
+
+        case 10:
+        {
+            _kernels->index(INDEX_SET, &_I[0], &_v[x][0], nnn, _paddedCount);
+        }
+        break;
+
+        case 15:
+        {
+            if (kk == 0x1E)
+            {
+                _kernels->index(INDEX_ADD, &_I[0], &_v[x][0], 0, _paddedCount);
+            }
+            else if (kk == 0x29)
+            {
+                _kernels->index(INDEX_CHAR, &_I[0], &_v[x][0], 0, _paddedCount);
+            }
+            else
+            {
+                return false;
+            }
+        }
+        break;
+
+        default:
+        {
+            return false;
+        }
+    }
+
+    if (advance)
+    {
+        std::fill(_pc.begin(), _pc.end(), pc + 2);
+    }
+    for (size_t i = 0; i < _haltedLanes.size(); i++)
+    {
+        uint32_t lane = _haltedLanes[i];
+        const HaltedState& state = _haltedStates[i];
+        _pc[lane] = state.pc;
+        _I[lane] = state.I;
+        _v[x][lane] = state.vx;
+        _v[15][lane] = state.vf;
+    }
+    return true;
+}
+
+uint8_t BatchEngine::NextRandom(uint32_t lane)
+{
+    uint32_t state = _rng[lane];
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    _rng[lane] = state;
+    return (uint8_t)(state >> 24);
+}
+
+bool BatchEngine::DrawLane(uint32_t lane, uint8_t xRegister, uint8_t yRegister, uint8_t sizeInBytes)
+{
+    _v[15][lane] = 0;  // Assume no pixels are flipped
+
+    const uint8_t* ram = Ram(lane);
+    uint64_t* frame = &_frames[(size_t)lane * DISP_HEIGHT];
+    uint8_t x = _v[xRegister][lane] % 64;
+    uint8_t y = _v[yRegister][lane];
+    uint16_t I = _I[lane];
+
+    for (uint8_t i = 0; i < sizeInBytes; i++)
+    {
+        uint64_t bits = (uint64_t)ram[(I + i) & (RAM_SIZE - 1)] << 56;
+        bits = (x == 0) ? bits : ((bits >> x) | (bits << (64 - x)));
+        uint64_t& row = frame[(uint8_t)(y + i) % DISP_HEIGHT];
+        if ((row & bits) != 0)
+        {
+            _v[15][lane] = 1;  // Set VF if a set pixel was unset
+        }
+        row ^= bits;
+    }
+    return true;
+}
+
+bool BatchEngine::StepLane(uint32_t lane)
+{
+    uint8_t* ram = Ram(lane);
+    uint16_t& pc = _pc[lane];
+    if (pc >= RAM_SIZE - 1)
+    {
+        return false;
+    }
+
+    uint16_t instruction = (ram[pc] << 8) | ram[pc + 1];
+    uint8_t firstNibble = (instruction >> 12);
+    uint8_t x = (instruction & 0x0F00) >> 8;
+    uint8_t y = (instruction & 0x00F0) >> 4;
+    uint8_t kk = (instruction & 0x00FF);
+    uint16_t nnn = (instruction & 0x0FFF);
+    uint8_t& vx = _v[x][lane];
+    uint8_t& vy = _v[y][lane];
+    uint16_t& I = _I[lane];
+    uint16_t& sp = _sp[lane];
+    pc += 2;
+
+    switch (firstNibble)
+    {
+        case 0:
+        {
+            if (instruction == 0x00E0)
+            {
+                memset(&_frames[(size_t)lane * DISP_HEIGHT], 0, DISP_HEIGHT * sizeof(uint64_t));
+                return true;
+            }
+            else if (instruction == 0x00EE)
+            {
+                pc = *((uint16_t*)(ram + sp));
+                sp += 2;
+                return (sp <= STACK_OFFSET);
+            }
+        }
+        return false;
+
+        case 1:
+        {
+            pc = nnn;
+        }
+        return true;
+
+        case 11:
+        {
+            pc = nnn + _v[0][lane];
+        }
+        return true;
+
+        case 2:
+        {
+            sp -= 2;
+            *((uint16_t*)(ram + sp)) = pc;
+            pc = nnn;
+            _ramDiverged = true;
+        }
+        return (sp >= (STACK_OFFSET - (2 * STACK_DEPTH)));
+
+        case 3:
+        case 4:
+        {
+            if ((vx == kk) == (firstNibble == 3))
+            {
+                pc += 2;
+            }
+        }
+        return true;
+
+        case 5:
+        case 9:
+        {
+            if ((instruction & 0x000F) != 0)
+            {
+                return false;
+            }
+            if ((vx == vy) == (firstNibble == 5))
+            {
+                pc += 2;
+            }
+        }
+        return true;
+
+        case 6:
+        case 7:
+        case 8:
+        {
+            AluOp op;
+            switch ((firstNibble == 8) ? (instruction & 0x000F) : firstNibble + 0x10)
+            {
+                case 0x16: op = ALU_SET_IMM; break;
+                case 0x17: op = ALU_ADD_IMM; break;
+                case 0:    op = ALU_MOV; break;
+                case 1:    op = ALU_OR; break;
+                case 2:    op = ALU_AND; break;
+                case 3:    op = ALU_XOR; break;
+                case 4:    op = ALU_ADD; break;
+                case 5:    op = ALU_SUB; break;
+                case 6:    op = ALU_SHR; break;
+                case 7:    op = ALU_SUBN; break;
+                case 14:   op = ALU_SHL; break;
+                default:   return false;
+            }
+            AluScalar(op, &vx, &vy, &_v[15][lane], kk, 1);
+        }
+        return true;
+
+        case 10:
+        {
+            I = nnn;
+        }
+        return true;
+
+        case 12:
+        {
+            vx = NextRandom(lane) & kk;
+        }
+        return true;
+
+        case 13:
+        {
+            return DrawLane(lane, x, y, instruction & 0x000F);
+        }
+
+        default:
+        {
+            switch (instruction & 0xF0FF)
+            {
+                case 0xE09E:
+                case 0xE0A1:
+                {
+                    bool keyIsPressed = (vx < 16) && ((_keys[lane] & (1 << vx)) != 0);
+                    if (keyIsPressed == ((instruction & 0xF0FF) == 0xE09E))
+                    {
+                        pc += 2;
+                    }
+                }
+                return true;
+
+                case 0xF007:
+                {
+                    vx = _delayTimer[lane];
+                }
+                return true;
+
+                case 0xF00A:
+                {
+                    // Stay on this instruction until a key is down
+                    if (_keys[lane] == 0)
+                    {
+                        pc -= 2;
+                        return true;
+                    }
+                    uint8_t key = 0;
+                    while ((_keys[lane] & (1 << key)) == 0)
+                    {
+                        key++;
+                    }
+                    vx = key;
+                }
+                return true;
+
+                case 0xF015:
+                {
+                    _delayTimer[lane] = vx;
+                }
+                return true;
+
+                case 0xF018:
+                {
+                    _soundTimer[lane] = vx;
+                }
+                return true;
+
+                case 0xF01E:
+                {
+                    I = I + vx;
+                }
+                return true;
+
+                case 0xF029:
+                {
+                    I = 5 * vx;
+                }
+                return true;
+
+                case 0xF033:
+                {
+                    uint8_t value = vx;
+                    ram[I & (RAM_SIZE - 1)] = value / 100;
+                    ram[(I + 1) & (RAM_SIZE - 1)] = (value % 100) / 10;
+                    ram[(I + 2) & (RAM_SIZE - 1)] = value % 10;
+                    _ramDiverged = true;
+                }
+                return true;
+
+                case 0xF055:
+                {
+                    for (uint8_t i = 0; i <= x; i++)
+                    {
+                        ram[(I + i) & (RAM_SIZE - 1)] = _v[i][lane];
+                    }
+                    _ramDiverged = true;
+                }
+                return true;
+
+                case 0xF065:
+                {
+                    for (uint8_t i = 0; i <= x; i++)
+                    {
+                        _v[i][lane] = ram[(I + i) & (RAM_SIZE - 1)];
+                    }
+                }
+                return true;
+            }
+        }
+        break;
+    }
+    return false;
+}
+
+const BatchEngine::Kernels* BatchEngine::SelectKernels()
+{
+#ifdef BATCH_X86
+    static const Kernels sse2 = { "sse2", AluSse2, IndexSse2, SkipSse2 };
+    static const Kernels avx2 = { "avx2", AluAvx2, IndexAvx2, SkipAvx2 };
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return &avx2;
+    }
+    return &sse2;
+#else
+    static const Kernels scalar = { "scalar", AluScalar, IndexScalar, SkipScalar };
+    return &scalar;
+#endif
+}
+} /* namespace chip8 */
@@ -0,0 +1,156 @@
+#ifndef BATCHENGINE_H_
+#define BATCHENGINE_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace chip8
+{
+    /**
+     * Runs many independent CHIP-8 machines in lockstep on one thread.
+     *
+     * Machine state is kept in structure-of-arrays form: register V3 of
+     * every lane is one contiguous array, and so on.  While all lanes sit
+     * at the same PC on the same opcode, register and control flow opcodes
+     * execute for every lane at once with SSE2/AVX2 kernels.  When lanes
+     * diverge, or for opcodes with side effects (draws, keys, memory,
+     * random), each lane is stepped on its own until they converge again.
+     *
+     * The lanes are headless: the screen is a packed framebuffer per lane,
+     * keys are set by the host and there is no sound.  A lane that hits an
+     * invalid instruction halts and keeps the state it halted with, which
+     * the SIMD kernels preserve even though they run over every lane.
+     */
+    class BatchEngine
+    {
+    public:
+        static const uint16_t RAM_SIZE      = 0x1000;
+        static const uint16_t ROM_OFFSET    = 0x200;
+        static const uint16_t STACK_OFFSET  = 0xF00;
+        static const uint8_t  STACK_DEPTH   = 16;
+        static const uint8_t  DISP_HEIGHT   = 32;
+        static const uint32_t LANE_ALIGN    = 32;   // Lanes per AVX2 vector
+
+        struct Stats
+        {
+            uint64_t instructions;  // Summed over all running lanes
+            uint64_t vectorSteps;   // Steps run by a SIMD kernel
+            uint64_t scalarSteps;   // Steps run lane by lane
+            double   seconds;
+
+            double InstructionsPerSecond() const;
+        };
+
+        /**
+         * Constructor
+         * @param laneCount The number of machines to run
+         */
+        BatchEngine(uint32_t laneCount);
+        virtual ~BatchEngine();
+
+        /**
+         * Loads the same ROM into every lane
+         * @param src The address of the ROM
+         * @param length The length of the ROM in bytes
+         * @return True if the ROM fits in memory
+         */
+        bool LoadRom(const uint8_t* src, uint16_t length);
+
+        /**
+         * Resets the registers, timers and screens of every lane.  Memory
+         * is left as it is.
+         */
+        void Reset();
+
+        /**
+         * Seeds the random number generators.  Lane n uses seed + n.
+         * @param seed The base seed
+         */
+        void SetSeed(uint32_t seed);
+
+        /**
+         * Sets which keys are held down for one lane
+         * @param lane The lane
+         * @param keyMask Bit n set if key n is down
+         */
+        void SetKeys(uint32_t lane, uint16_t keyMask);
+
+        /**
+         * Runs every lane for a number of 60 Hz frames
+         * @param frames The number of frames to run
+         * @param instructionsPerFrame Instructions per lane per frame
+         * @return Counters for this call
+         */
+        Stats RunFrames(uint32_t frames, uint16_t instructionsPerFrame);
+
+        uint32_t GetLaneCount() const;
+        bool IsHalted(uint32_t lane) const;
+        uint8_t GetRegister(uint32_t lane, uint8_t reg) const;
+        uint16_t GetPC(uint32_t lane) const;
+        uint16_t GetI(uint32_t lane) const;
+
+        /**
+         * Returns the screen of a lane, one uint64_t per row with the
+         * leftmost pixel in the most significant bit
+         * @param lane The lane
+         * @return DISP_HEIGHT rows
+         */
+        const uint64_t* GetFrame(uint32_t lane) const;
+
+        /**
+         * Returns the name of the SIMD kernels in use
+         * @return "avx2", "sse2" or "scalar"
+         */
+        const char* GetKernelName() const;
+
+    protected:
+        struct Kernels;
+
+        // What a vector step could overwrite in a halted lane
+        struct HaltedState
+        {
+            uint16_t pc;
+            uint16_t I;
+            uint8_t  vx;
+            uint8_t  vf;
+        };
+
+        static const Kernels* SelectKernels();
+
+        bool Tick();
+        bool CheckConverged(uint16_t& instruction);
+        bool StepVector(uint16_t instruction);
+        bool StepLane(uint32_t lane);
+        bool DrawLane(uint32_t lane, uint8_t xRegister, uint8_t yRegister, uint8_t sizeInBytes);
+        uint8_t NextRandom(uint32_t lane);
+        uint8_t* Ram(uint32_t lane);
+
+        uint32_t                _laneCount;
+        uint32_t                _paddedCount;
+        std::vector<uint8_t>    _v[16];
+        std::vector<uint16_t>   _pc;
+        std::vector<uint16_t>   _I;
+        std::vector<uint16_t>   _sp;
+        std::vector<uint8_t>    _delayTimer;
+        std::vector<uint8_t>    _soundTimer;
+        std::vector<uint16_t>   _keys;
+        std::vector<uint32_t>   _rng;
+        std::vector<uint8_t>    _halted;
+        std::vector<uint32_t>   _haltedLanes;   // Real lanes only, in halting order
+        std::vector<HaltedState> _haltedStates; // Scratch, one per halted lane
+        std::vector<uint8_t>    _ram;       // Lane major, RAM_SIZE per lane
+        std::vector<uint64_t>   _frames;    // Lane major, DISP_HEIGHT per lane
+
+        uint32_t                _runningLanes;
+        bool                    _converged;     // Every running lane has the same PC
+        bool                    _ramDiverged;   // Some lane has written RAM since LoadRom
+        uint64_t                _instructions;
+        uint64_t                _vectorSteps;
+        uint64_t                _scalarSteps;
+
+        const Kernels*          _kernels;
+    };
+
+} /* namespace chip8 */
+
+#endif /* BATCHENGINE_H_ */
@@ -1,27 +1,36 @@
 #ifndef BEEPER_H_
 #define BEEPER_H_
 
-#include <mutex>
-#include <thread>
+#include <stdint.h>
 
 namespace chip8
 {
-
+    /**
+     * Interface for the tone that plays while the sound timer is non-zero
+     */
     class Beeper
     {
     public:
-        Beeper();
-        virtual ~Beeper();
+        virtual ~Beeper() {}
+
+        virtual bool StartBeeping() = 0;
+        virtual bool StopBeeping() = 0;
 
-        bool StartBeeping();
-        bool StopBeeping();
-        void BeepThread();
+        /**
+         * Tells the beeper where emulated time has got to within the
+         * current frame, just before a StartBeeping or StopBeeping.
+         * Backends that play in real time can ignore it.
+         * @param cycles Instructions executed so far
+         * @param instructionsPerFrame Instructions in one 60 Hz frame
+         */
+        virtual void Advance(uint64_t cycles, uint32_t instructionsPerFrame) {}
 
-    protected:
-        std::mutex      _beepLock;
-        bool            _isBeeping;
-        std::thread*    _beepThread;
-        bool            _isAlive;
+        /**
+         * Marks the end of a 60 Hz frame of emulated time, before the
+         * timers tick
+         * @param cycles Instructions executed so far
+         */
+        virtual void EndFrame(uint64_t cycles) {}
     };
 
 } /* namespace chip8 */
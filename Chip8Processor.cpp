@@ -3,11 +3,22 @@
 #include "Display.h"
 #include "Keyboard.h"
 #include "Beeper.h"
+#include "Hooks.h"
+#include "Recompiler.h"
+#include "StaticProgram.h"
+#include "Chip8State.h"
+#include "InputRecorder.h"
+#include "InputReplayer.h"
+#include "Profiler.h"
+#include "FrameSink.h"
+#include "RomPack.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 #include <chrono>
+#include <new>
 
 #define LOG_TAG "Chip8Processor"
 #include "log.h"
@@ -15,12 +26,32 @@ namespace chip8
 {
 
 Chip8Processor::Chip8Processor(Keyboard* keyboard, Display* display, Beeper* beeper)
-: _runThread(NULL)
-, _timerThread(NULL)
+: _idleSkipping(true)
+, _waitingForKey(false)
+, _keyWaitStarted(false)
+, _executionMode(EXEC_PREDECODED)
+, _recompiler(NULL)
+, _staticProgram(NULL)
+, _romHash(0)
+, _recorder(NULL)
+, _replayer(NULL)
+, _profiler(NULL)
+, _debugger(NULL)
+, _frameSink(NULL)
+, _instructionsPerFrame(DEFAULT_INSTRUCTIONS_PER_FRAME)
+, _turbo(false)
+, _nextSequence(0)
+, _paused(false)
+, _frameProgress(0)
+, _run(false)
+, _runThread(NULL)
 , _keyboard(keyboard)
 , _display(display)
 , _beeper(beeper)
 {
+    std::random_device seed;
+    SetRandomSeed(seed());
+    _activeCommand.type = COMMAND_NONE;
     Reset();
 
     uint8_t fontData[] =
@@ -42,27 +73,55 @@ Chip8Processor::Chip8Processor(Keyboard* keyboard, Display* display, Beeper* bee
             0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
             0xF0, 0x80, 0xF0, 0x80, 0x80 // F
     };
+    memset(_RAM, 0, sizeof(_RAM));
     memcpy(_RAM, fontData, sizeof(fontData));
+    InvalidateRange(0, RAM_SIZE);
 }
 
 Chip8Processor::~Chip8Processor()
 {
     Stop();
+    delete _recompiler;
+    delete _staticProgram;
+}
+
+void* Chip8Processor::operator new(size_t size)
+{
+    void* memory = NULL;
+    if (posix_memalign(&memory, alignof(Chip8Processor), size) != 0)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void Chip8Processor::operator delete(void* memory)
+{
+    free(memory);
 }
 
 bool Chip8Processor::LoadRom(const uint8_t* src, uint16_t length)
 {
-    LOG("%s: %d", __FUNCTION__, length);
-    if (length > (Chip8Processor::RAM_SIZE - Chip8Processor::ROM_OFFSET))
+    RomView rom = { NULL, src, length, RomPack::Hash(src, length) };
+    return LoadRom(rom);
+}
+
+bool Chip8Processor::LoadRom(const RomView& rom)
+{
+    LOG("%s: %d", __FUNCTION__, rom.length);
+    if (rom.length > (Chip8Processor::RAM_SIZE - Chip8Processor::ROM_OFFSET))
     {
-        LOG("Length is too long: %d", length);
+        LOG_ERROR("Length is too long: %d", rom.length);
         return false;
     }
 
-    for (uint16_t i = 0; i < length; i++)
+    memcpy(_RAM + Chip8Processor::ROM_OFFSET, rom.data, rom.length);
+    _romHash = rom.hash;
+    if (_staticProgram != NULL)
     {
-        _RAM[i + Chip8Processor::ROM_OFFSET] = src[i];
+        _staticProgram->Attach(StaticProgram::Find(_romHash));
     }
+    InvalidateRange(Chip8Processor::ROM_OFFSET, rom.length);
     LOG("ROM Loaded!");
     return true;
 }
@@ -71,118 +130,1003 @@ bool Chip8Processor::Reset()
 {
     Stop();
 
-    memset(_v, sizeof(_v), 0);
+    memset(_v, 0, sizeof(_v));
     _I = 0;
     _pc = ROM_OFFSET;
     _sp = STACK_OFFSET;
     _delayTimer = 0;
     _soundTimer = 0;
+    _cycles = 0;
+    _idleCycles = 0;
+    _frameProgress = 0;
+    _keyWaitStarted = false;
+
+    return true;
+}
+
+bool Chip8Processor::Run()
+{
+    if (_runThread != NULL)
+    {
+        if (_run.load())
+        {
+            return true;
+        }
+        // The thread exited after a failed instruction
+        JoinExecutionThread();
+    }
+
+    _paused = false;
+    _activeCommand.type = COMMAND_NONE;
+    _run.store(true);
+    _keyboard->CancelWait(false);
+    _runThread = new std::thread(&Chip8Processor::ExecutionThread, this);
+    LOG("Execution thread started");
+    return true;
+}
+
+bool Chip8Processor::Stop()
+{
+    if (_runThread == NULL)
+    {
+        return false;
+    }
+
+    if (_run.load())
+    {
+        // The queue only fills up if the thread is busy, so it drains soon,
+        // unless the thread has stopped on its own in the meantime
+        while (_run.load() && (SendCommand(COMMAND_STOP, 0, 0) == 0))
+        {
+            std::this_thread::yield();
+        }
+    }
+    JoinExecutionThread();
+    return _run.load();
+}
+
+bool Chip8Processor::IsRunning()
+{
+    return _run.load(std::memory_order_relaxed);
+}
+
+uint32_t Chip8Processor::Pause()
+{
+    return SendCommand(COMMAND_PAUSE, 0, 0);
+}
+
+uint32_t Chip8Processor::Resume()
+{
+    return SendCommand(COMMAND_RESUME, 0, 0);
+}
+
+uint32_t Chip8Processor::StepInstructions(uint32_t count)
+{
+    return SendCommand(COMMAND_STEP, count, 0);
+}
+
+uint32_t Chip8Processor::RunUntil(uint16_t address)
+{
+    return SendCommand(COMMAND_RUN_UNTIL, 0, address);
+}
+
+bool Chip8Processor::PollAcknowledgement(Acknowledgement& ack)
+{
+    return _acknowledgements.Pop(ack);
+}
+
+bool Chip8Processor::WaitForAcknowledgement(uint32_t sequence, Acknowledgement& ack, uint32_t timeoutUs)
+{
+    std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::microseconds(timeoutUs);
+    do
+    {
+        bool running = _run.load();
+        while (_acknowledgements.Pop(ack))
+        {
+            if (ack.sequence == sequence)
+            {
+                return true;
+            }
+        }
+        if (!running)
+        {
+            // Nothing more is coming
+            return false;
+        }
+        std::this_thread::yield();
+    } while (std::chrono::steady_clock::now() < deadline);
+    return false;
+}
+
+uint32_t Chip8Processor::SendCommand(CommandType type, uint32_t count, uint16_t address)
+{
+    uint32_t sequence = _nextSequence + 1;
+    if (sequence == 0)
+    {
+        sequence = 1;   // 0 means the queue was full
+    }
+    Command command = { (uint8_t)type, sequence, count, address };
+    if (!_commands.Push(command))
+    {
+        LOG_ERROR("The command queue is full");
+        return 0;
+    }
+    _nextSequence = sequence;
+    Wake();
+    return sequence;
+}
+
+void Chip8Processor::Wake()
+{
+    // Taking the lock orders the push before the sleeper's last check
+    _wakeLock.lock();
+    _wakeLock.unlock();
+    _wakeCondition.notify_one();
+    _keyboard->CancelWait(true);    // Wakes a thread parked on Fx0A
+}
+
+void Chip8Processor::JoinExecutionThread()
+{
+    _runThread->join();
+    delete _runThread;
+    _runThread = NULL;
+
+    // Drop anything left over for the next run
+    _commands.Clear();
+    _acknowledgements.Clear();
+}
+
+void Chip8Processor::ExecutionThread()
+{
+    LOG("Starting execution thread");
+    const std::chrono::microseconds framePeriod(1000000 / FRAME_RATE);
+    std::chrono::steady_clock::time_point nextFrame = std::chrono::steady_clock::now();
+    while (true)
+    {
+        if (_commands.HasItems() && !HandleCommands())
+        {
+            break;
+        }
+        if (_paused)
+        {
+            SleepUntilCommand(NULL);
+            nextFrame = std::chrono::steady_clock::now();
+            continue;
+        }
+
+        bool succeeded = (_activeCommand.type != COMMAND_NONE) ? StepFrame() : RunFrame();
+        if (!succeeded)
+        {
+            LOG_ERROR("The instruction failed to execute properly");
+            break;
+        }
+        if (_paused)
+        {
+            continue;
+        }
+
+        // Waiting on Fx0A with both timers stopped, nothing can happen
+        // until a key is pressed.  Sleep until then, or until a command.
+        if (_waitingForKey && (_delayTimer == 0) && (_soundTimer == 0) && (_replayer == NULL))
+        {
+            _keyboard->CancelWait(false);
+            if (!_commands.HasItems())
+            {
+                LOG("Waiting for a key");
+                _keyboard->WaitForKeyPress();
+            }
+            nextFrame = std::chrono::steady_clock::now();
+            continue;
+        }
+
+        if (!_turbo)
+        {
+            // Sleep once per frame.  If we fell behind, start over from now
+            // rather than running a burst of frames to catch up.
+            nextFrame += framePeriod;
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (nextFrame < now)
+            {
+                nextFrame = now;
+            }
+            SleepUntilCommand(&nextFrame);
+        }
+    }
+    _run.store(false);
+    LOG("Execution thread stopped");
+}
+
+void Chip8Processor::SleepUntilCommand(const std::chrono::steady_clock::time_point* deadline)
+{
+    std::unique_lock<std::mutex> lock(_wakeLock);
+    while (!_commands.HasItems())
+    {
+        if (deadline == NULL)
+        {
+            _wakeCondition.wait(lock);
+        }
+        else if (_wakeCondition.wait_until(lock, *deadline) == std::cv_status::timeout)
+        {
+            break;
+        }
+    }
+}
+
+bool Chip8Processor::HandleCommands()
+{
+    Command command;
+    while (_commands.Pop(command))
+    {
+        // A new command cuts short a step or run-until in progress
+        if (_activeCommand.type != COMMAND_NONE)
+        {
+            Acknowledge(_activeCommand, false);
+            _activeCommand.type = COMMAND_NONE;
+        }
+
+        switch (command.type)
+        {
+            case COMMAND_PAUSE:
+            {
+                _paused = true;
+                Acknowledge(command, true);
+                break;
+            }
+            case COMMAND_RESUME:
+            {
+                _paused = false;
+                Acknowledge(command, true);
+                break;
+            }
+            case COMMAND_STEP:
+            case COMMAND_RUN_UNTIL:
+            {
+                if ((command.type == COMMAND_STEP) && (command.count == 0))
+                {
+                    _paused = true;
+                    Acknowledge(command, true);
+                }
+                else
+                {
+                    _paused = false;
+                    _activeCommand = command;
+                }
+                break;
+            }
+            case COMMAND_STOP:
+            {
+                Acknowledge(command, true);
+                return false;
+            }
+            default:
+            {
+                LOG_ERROR("Unknown command %u", command.type);
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+void Chip8Processor::Acknowledge(const Command& command, bool completed)
+{
+    Acknowledgement ack = { command.sequence, command.type, completed, _paused, _pc, _cycles };
+    if (!_acknowledgements.Push(ack))
+    {
+        // The host is not reading them; it would rather lose one than stall us
+        LOG_DEBUG("Dropped acknowledgement %u", command.sequence);
+    }
+}
+
+bool Chip8Processor::StepFrame()
+{
+    if (_debugger != NULL)
+    {
+        return StepFrameWith<DebugHooks>();
+    }
+    return StepFrameWith<NoHooks>();
+}
+
+template <typename Hooks>
+bool Chip8Processor::StepFrameWith()
+{
+    // One instruction at a time, so a command or the debugger can stop
+    // anywhere in a frame.  The frame still ends where RunFrame would have
+    // ended it.
+    _waitingForKey = false;
+    while (_frameProgress < _instructionsPerFrame)
+    {
+        uint64_t cycles = _cycles;
+        if (!StepWith<Hooks>())
+        {
+            return false;
+        }
+
+        // A breakpoint stops before its instruction runs
+        bool done = false;
+        if (_cycles != cycles)
+        {
+            _frameProgress++;
+            if (_activeCommand.type == COMMAND_STEP)
+            {
+                done = (--_activeCommand.count == 0);
+            }
+            else if (_activeCommand.type == COMMAND_RUN_UNTIL)
+            {
+                done = (_pc == _activeCommand.address);
+            }
+        }
+
+        if (_waitingForKey)
+        {
+            uint32_t skipped = _instructionsPerFrame - _frameProgress;
+            _cycles += skipped;
+            _idleCycles += skipped;
+            _frameProgress = _instructionsPerFrame;
+        }
+
+        if (done)
+        {
+            _paused = true;
+            Acknowledge(_activeCommand, true);
+            _activeCommand.type = COMMAND_NONE;
+            break;
+        }
+
+        if (Hooks::ENABLED && (_debugger->TakeBreak() != Debugger::BREAK_NONE))
+        {
+            _paused = true;
+            if (_activeCommand.type != COMMAND_NONE)
+            {
+                Acknowledge(_activeCommand, false);
+                _activeCommand.type = COMMAND_NONE;
+            }
+            Command event = { COMMAND_BREAK, 0, 0, 0 };
+            Acknowledge(event, true);
+            break;
+        }
+    }
+
+    if (_frameProgress >= _instructionsPerFrame)
+    {
+        EndFrame();
+    }
+    return true;
+}
+
+bool Chip8Processor::RunFrame()
+{
+    if (_debugger != NULL)
+    {
+        return StepFrame();
+    }
+
+    bool succeeded = true;
+    _waitingForKey = false;
+    bool runBlocks = ((_executionMode == EXEC_RECOMPILER) || (_executionMode == EXEC_STATIC)) && (_profiler == NULL);
+    // A step or run-until may have stopped partway through the frame
+    uint32_t executed = _frameProgress;
+    while (executed < _instructionsPerFrame)
+    {
+        uint16_t pc = _pc;
+        uint32_t count = 0;
+        if (runBlocks)
+        {
+            if (_executionMode == EXEC_STATIC)
+            {
+                // Compiled blocks count their own cycles
+                count = _staticProgram->Execute(*this, _instructionsPerFrame - executed, succeeded);
+                if (!succeeded)
+                {
+                    break;
+                }
+            }
+            else
+            {
+                count = _recompiler->Execute(_v, &_I, &_pc, _instructionsPerFrame - executed);
+                _cycles += count;
+            }
+        }
+        if (count == 0)
+        {
+            if (!StepWith<NoHooks>())
+            {
+                succeeded = false;
+                break;
+            }
+            count = 1;
+        }
+        executed += count;
+
+        if (_waitingForKey)
+        {
+            // The rest of the frame would poll Fx0A over and over
+            uint32_t skipped = _instructionsPerFrame - executed;
+            _cycles += skipped;
+            _idleCycles += skipped;
+            break;
+        }
+
+        // An idle loop can only be entered through its backward jump
+        if (_pc <= pc)
+        {
+            executed += SkipIdleLoop(_instructionsPerFrame - executed);
+        }
+    }
+
+    // Show what was drawn this frame, even if it ended in a failure
+    EndFrame();
+    return succeeded;
+}
+
+void Chip8Processor::EndFrame()
+{
+    // Timers count down at 60 Hz of emulated time, one tick per frame.
+    // A tone that stops on this tick stops on the frame boundary.
+    _beeper->EndFrame(_cycles);
+    TickTimers();
+
+    _display->Present();
+    if (_frameSink != NULL)
+    {
+        _frameSink->OnFrame(_display->GetFrame());
+    }
+    _frameProgress = 0;
+}
+
+uint64_t Chip8Processor::GetCycles() const
+{
+    return _cycles;
+}
+
+uint64_t Chip8Processor::GetIdleCycles() const
+{
+    return _idleCycles;
+}
+
+void Chip8Processor::SetIdleSkipping(bool enabled)
+{
+    _idleSkipping = enabled;
+}
+
+uint32_t Chip8Processor::SkipIdleLoop(uint32_t budget)
+{
+    if (!_idleSkipping || (_profiler != NULL))
+    {
+        return 0;
+    }
+    uint32_t length = MeasureIdleLoop(_pc);
+    if ((length == 0) || (length > budget))
+    {
+        return 0;
+    }
+
+    // Every remaining whole iteration would end right back here
+    uint32_t skipped = budget - (budget % length);
+    _cycles += skipped;
+    _idleCycles += skipped;
+    LOG_TRACE("Skipped %u instructions idling at 0x%x", skipped, _pc);
+    return skipped;
+}
+
+uint32_t Chip8Processor::MeasureIdleLoop(uint16_t head) const
+{
+    // Runs one iteration on a copy of the registers.  The loop is idle if
+    // it only reads the delay timer and the keys, jumps back to the head
+    // and leaves the registers as it found them.
+    uint8_t v[16];
+    memcpy(v, _v, sizeof(v));
+    uint16_t pc = head;
+    for (uint32_t length = 1; length <= MAX_IDLE_LOOP; length++)
+    {
+        if ((pc & 1) || (pc >= RAM_SIZE - 1))
+        {
+            return 0;
+        }
+        uint16_t instruction = (_RAM[pc] << 8) | _RAM[pc + 1];
+        uint8_t xRegister = (instruction & 0x0F00) >> 8;
+        uint8_t yRegister = (instruction & 0x00F0) >> 4;
+        uint8_t value = (instruction & 0x00FF);
+        bool skip = false;
+        switch (instruction >> 12)
+        {
+            case 1:
+            {
+                bool isIdle = ((instruction & 0x0FFF) == head) && (memcmp(v, _v, sizeof(v)) == 0);
+                return isIdle ? length : 0;
+            }
+            case 3:
+            case 4:
+            {
+                skip = ((v[xRegister] == value) == ((instruction >> 12) == 3));
+            }
+            break;
+
+            case 5:
+            case 9:
+            {
+                if ((instruction & 0x000F) != 0)
+                {
+                    return 0;
+                }
+                skip = ((v[xRegister] == v[yRegister]) == ((instruction >> 12) == 5));
+            }
+            break;
+
+            case 14:
+            {
+                if (((value != 0x9E) && (value != 0xA1)) || (_recorder != NULL) || (_replayer != NULL))
+                {
+                    return 0;
+                }
+                skip = (_keyboard->IsKeyDown(v[xRegister]) == (value == 0x9E));
+            }
+            break;
+
+            case 15:
+            {
+                if (value != 0x07)
+                {
+                    return 0;
+                }
+                v[xRegister] = _delayTimer;
+            }
+            break;
+
+            default:
+            {
+                return 0;
+            }
+        }
+        pc += skip ? 4 : 2;
+    }
+    return 0;
+}
+
+void Chip8Processor::SaveState(Chip8State& state) const
+{
+    static_assert(sizeof(state.ram) == RAM_SIZE, "Chip8State does not match RAM_SIZE");
+    state.magic = Chip8State::MAGIC;
+    state.version = Chip8State::VERSION;
+    state.size = sizeof(Chip8State);
+    memcpy(state.v, _v, sizeof(state.v));
+    state.pc = _pc;
+    state.sp = _sp;
+    state.I = _I;
+    state.delayTimer = _delayTimer;
+    state.soundTimer = _soundTimer;
+    state.cycles = _cycles;
+    state.randomState = _randomState;
+    memcpy(state.frame, _display->GetFrame().GetRows(), sizeof(state.frame));
+    memcpy(state.ram, _RAM, sizeof(state.ram));
+}
+
+bool Chip8Processor::LoadState(const Chip8State& state)
+{
+    if (!state.IsValid())
+    {
+        LOG_ERROR("Incompatible state: magic %x, version %u, size %u", state.magic, state.version, state.size);
+        return false;
+    }
+
+    memcpy(_v, state.v, sizeof(_v));
+    _pc = state.pc;
+    _sp = state.sp;
+    _I = state.I;
+    _delayTimer = state.delayTimer;
+    _soundTimer = state.soundTimer;
+    _cycles = state.cycles;
+    _frameProgress = 0;
+    _keyWaitStarted = false;
+    SetRandomState(state.randomState);
+    memcpy(_RAM, state.ram, sizeof(_RAM));
+    InvalidateRange(0, RAM_SIZE);
+
+    FrameBuffer frame;
+    frame.SetRows(state.frame);
+    _display->SetFrame(frame);
+
+    if (_soundTimer > 0)
+    {
+        _beeper->StartBeeping();
+    }
+    else
+    {
+        _beeper->StopBeeping();
+    }
+    return true;
+}
+
+void Chip8Processor::SetInputRecorder(InputRecorder* recorder)
+{
+    _recorder = recorder;
+}
+
+void Chip8Processor::SetInputReplayer(InputReplayer* replayer)
+{
+    _replayer = replayer;
+}
+
+void Chip8Processor::SetProfiler(Profiler* profiler)
+{
+    _profiler = profiler;
+}
+
+void Chip8Processor::SetDebugger(Debugger* debugger)
+{
+    _debugger = debugger;
+}
+
+Debugger* Chip8Processor::GetDebugger() const
+{
+    return _debugger;
+}
+
+void Chip8Processor::SetFrameSink(FrameSink* sink)
+{
+    _frameSink = sink;
+}
+
+void Chip8Processor::SetRandomSeed(uint32_t seed)
+{
+    SetRandomState(seed);
+}
+
+uint32_t Chip8Processor::GetRandomState() const
+{
+    return _randomState;
+}
+
+void Chip8Processor::SetRandomState(uint32_t state)
+{
+    // xorshift32 must not start at zero
+    _randomState = state ? state : 0x9E3779B9;
+}
+
+void Chip8Processor::SetInstructionsPerFrame(uint16_t count)
+{
+    _instructionsPerFrame = count;
+}
+
+void Chip8Processor::SetTurbo(bool turbo)
+{
+    _turbo = turbo;
+}
+
+bool Chip8Processor::SetExecutionMode(ExecutionMode mode)
+{
+    if (mode == EXEC_RECOMPILER)
+    {
+        if (_recompiler == NULL)
+        {
+            _recompiler = new Recompiler(_RAM, RAM_SIZE);
+        }
+        if (!_recompiler->IsSupported())
+        {
+            LOG_ERROR("The recompiler is not supported on this host");
+            return false;
+        }
+        _recompiler->Flush();
+    }
+    else if (mode == EXEC_STATIC)
+    {
+        if (_staticProgram == NULL)
+        {
+            _staticProgram = new StaticProgram(_RAM, RAM_SIZE);
+        }
+        _staticProgram->Attach(StaticProgram::Find(_romHash));
+        if (!_staticProgram->IsAttached())
+        {
+            LOG("No ahead-of-time code for this ROM, running predecoded");
+        }
+    }
+    _executionMode = mode;
+    return true;
+}
+
+bool Chip8Processor::Step()
+{
+    if (_debugger != NULL)
+    {
+        return StepWith<DebugHooks>();
+    }
+    return StepWith<NoHooks>();
+}
+
+template <typename Hooks>
+bool Chip8Processor::StepWith()
+{
+    if (Hooks::ENABLED)
+    {
+        // The debugger sees every instruction and every RAM write, which
+        // only the interpreter reports
+        uint16_t instruction = _RAM[_pc];
+        instruction <<= 8;
+        instruction += _RAM[_pc+1];
+        if (!Hooks::BeforeInstruction(*this, _pc, instruction))
+        {
+            return true;
+        }
+        _cycles++;
+        if (_profiler != NULL)
+        {
+            return ProfileStep();
+        }
+        return HandleInstruction<Hooks>(instruction);
+    }
+
+    _cycles++;
+    if (_profiler != NULL)
+    {
+        return ProfileStep();
+    }
+    if ((_executionMode != EXEC_INTERPRETER) && ((_pc & 1) == 0) && (_pc < RAM_SIZE))
+    {
+        LOG_TRACE("pc = 0x%x", _pc);
+        DecodedInstruction& op = _decoded[_pc >> 1];
+        if (op.handler == NULL)
+        {
+            Decode(_pc, op);
+        }
+        _pc += 2;
+        return op.handler(*this, op);
+    }
+
+    uint16_t instruction = _RAM[_pc];
+    instruction <<= 8;
+    instruction += _RAM[_pc+1];
+
+    LOG_TRACE("pc = 0x%x", _pc);
+    return HandleInstruction<Hooks>(instruction);
+}
 
-    return true;
+bool Chip8Processor::ProfileStep()
+{
+    uint16_t pc = _pc;
+    uint16_t instruction = _RAM[pc];
+    instruction <<= 8;
+    instruction += _RAM[pc+1];
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool succeeded = (_debugger != NULL) ? HandleInstruction<DebugHooks>(instruction) : HandleInstruction<NoHooks>(instruction);
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    _profiler->Record(pc, instruction, _pc, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    return succeeded;
 }
 
-bool Chip8Processor::Run()
+void Chip8Processor::InvalidateRange(uint16_t address, uint16_t length)
 {
-    _runLock.lock();
-    LOG("Got lock");
-    if (!_run)
+    if ((length == 0) || (address >= RAM_SIZE))
     {
-        _run = true;
-        _runThread = new std::thread(&Chip8Processor::ExecutionThread, this);
-        LOG("Execution thread started");
-        _timerThread = new std::thread(&Chip8Processor::TimerThread, this);
+        return;
+    }
+    uint32_t end = (uint32_t)address + length;
+    if (end > RAM_SIZE)
+    {
+        end = RAM_SIZE;
     }
-    _runLock.unlock();
-    return _run;
-}
 
-bool Chip8Processor::Stop()
-{
-    _runLock.lock();
-    if (_run)
+    if (_recompiler != NULL)
+    {
+        _recompiler->Invalidate(address, end - address);
+    }
+    if (_staticProgram != NULL)
     {
-        _run = false;
-        _runThread->join();
-        delete _runThread;
-        _runThread = NULL;
+        _staticProgram->Invalidate(address, end - address);
+    }
 
-        _timerThread->join();
-        delete _timerThread;
-        _timerThread = NULL;
+    // Entry n covers bytes 2n and 2n+1
+    for (uint32_t entry = (address >> 1); entry <= ((end - 1) >> 1); entry++)
+    {
+        _decoded[entry].handler = NULL;
     }
-    _runLock.unlock();
-    return _run;
 }
 
-bool Chip8Processor::IsRunning()
+void Chip8Processor::Decode(uint16_t address, DecodedInstruction& op)
 {
-    return _run;
-}
+    uint16_t instruction = _RAM[address];
+    instruction <<= 8;
+    instruction += _RAM[address+1];
 
-void Chip8Processor::ExecutionThread()
-{
-    LOG("Starting execution thread");
-    while(_run)
+    uint8_t firstNibble = ((instruction & 0xF000) >> 12);
+    op.address = (instruction & 0x0FFF);
+    op.x = (instruction & 0x0F00) >> 8;
+    op.y = (instruction & 0x00F0) >> 4;
+    op.value = (instruction & 0x00FF);
+    op.flag = false;
+    op.handler = &Chip8Processor::ExecInvalid;
+
+    switch (firstNibble)
     {
-        if (!Step())
+        case 0:
         {
-            LOG("The instruction failed to execute properly");
-            return;
+            if (instruction == 0x00E0)
+            {
+                op.handler = &Chip8Processor::ExecClearScreen;
+            }
+            else if (instruction == 0x00EE)
+            {
+                op.handler = &Chip8Processor::ExecReturn;
+            }
         }
-        std::chrono::microseconds period(500);
-        std::this_thread::sleep_for(period);
-    }
-    return;
-}
+        break;
 
-bool Chip8Processor::Step()
-{
-    uint16_t instruction = _RAM[_pc];
-    instruction <<= 8;
-    instruction += _RAM[_pc+1];
+        case 1:
+        {
+            op.handler = &Chip8Processor::ExecJump;
+        }
+        break;
 
-    LOG("pc = 0x%x", _pc);
-    return HandleInstruction(instruction);
-}
+        case 11:
+        {
+            op.handler = &Chip8Processor::ExecJumpOffset;
+        }
+        break;
 
-void Chip8Processor::TimerThread()
-{
-    LOG("Starting timer thread");
-    while(_run)
-    {
-        LOG("tick!");
-        _timerLock.lock();
+        case 2:
+        {
+            op.handler = &Chip8Processor::ExecCall;
+        }
+        break;
+
+        case 3:
+        case 4:
+        {
+            op.flag = (firstNibble == 3);
+            op.handler = &Chip8Processor::ExecSkipValue;
+        }
+        break;
+
+        case 5:
+        case 9:
+        {
+            if ((instruction & 0x000F) == 0)
+            {
+                op.flag = (firstNibble == 5);
+                op.handler = &Chip8Processor::ExecSkipXY;
+            }
+        }
+        break;
+
+        case 6:
+        {
+            op.handler = &Chip8Processor::ExecSetByValue;
+        }
+        break;
+
+        case 7:
+        {
+            op.handler = &Chip8Processor::ExecAddToRegister;
+        }
+        break;
+
+        case 8:
+        {
+            op.value = (instruction & 0x000F);
+            op.handler = &Chip8Processor::ExecMath;
+        }
+        break;
+
+        case 10:
+        {
+            op.handler = &Chip8Processor::ExecSetIRegister;
+        }
+        break;
 
-        if (_delayTimer != 0)
+        case 12:
         {
-            _delayTimer--;
+            op.handler = &Chip8Processor::ExecSetRandom;
         }
+        break;
 
+        case 13:
+        {
+            op.value = (instruction & 0x000F);
+            op.handler = &Chip8Processor::ExecDrawSprite;
+        }
+        break;
 
-        if (_soundTimer != 0)
+        default:
         {
-            _soundTimer--;
-            if (_soundTimer == 0)
+            switch (instruction & 0xF0FF)
             {
-                _beeper->StopBeeping();
+                case 0xE09E:
+                case 0xE0A1:
+                {
+                    op.flag = ((instruction & 0xF0FF) == 0xE09E);
+                    op.handler = &Chip8Processor::ExecSkipKeyPress;
+                }
+                break;
+
+                case 0xF007:
+                {
+                    op.handler = &Chip8Processor::ExecStoreDelayTimer;
+                }
+                break;
+
+                case 0xF00A:
+                {
+                    op.handler = &Chip8Processor::ExecWaitAndStoreKey;
+                }
+                break;
+
+                case 0xF015:
+                {
+                    op.handler = &Chip8Processor::ExecSetDelayTimer;
+                }
+                break;
+
+                case 0xF018:
+                {
+                    op.handler = &Chip8Processor::ExecSetSoundTimer;
+                }
+                break;
+
+                case 0xF01E:
+                {
+                    op.handler = &Chip8Processor::ExecAddToI;
+                }
+                break;
+
+                case 0xF029:
+                {
+                    op.handler = &Chip8Processor::ExecSetIToChar;
+                }
+                break;
+
+                case 0xF033:
+                {
+                    op.handler = &Chip8Processor::ExecStoreBCD;
+                }
+                break;
+
+                case 0xF055:
+                {
+                    op.handler = &Chip8Processor::ExecStoreRegs;
+                }
+                break;
+
+                case 0xF065:
+                {
+                    op.handler = &Chip8Processor::ExecFillRegs;
+                }
+                break;
             }
         }
-        _timerLock.unlock();
-        std::chrono::microseconds period(16666);
-        std::this_thread::sleep_for(period);
+        break;
+    }
+}
+
+void Chip8Processor::TickTimers()
+{
+    LOG_TRACE("tick!");
+    if (_delayTimer != 0)
+    {
+        _delayTimer--;
+    }
+
+    if (_soundTimer != 0)
+    {
+        _soundTimer--;
+        if (_soundTimer == 0)
+        {
+            _beeper->StopBeeping();
+        }
     }
-    return;
 }
 
+template <typename Hooks>
 bool Chip8Processor::HandleInstruction(uint16_t instruction)
 {
-    LOG("%s: %x", __FUNCTION__, instruction);
+    LOG_TRACE("%s: %x", __FUNCTION__, instruction);
     uint8_t firstNibble = ((instruction & 0xF000) >> 12);
 
     uint8_t xRegister = (instruction & 0x0F00) >> 8;
     uint8_t yRegister = (instruction & 0x00F0) >> 4;
 
-    LOG("xRegister: %x, yRegister: %x", xRegister, yRegister);
+    LOG_TRACE("xRegister: %x, yRegister: %x", xRegister, yRegister);
     _pc += 2;
     switch (firstNibble)
     {
@@ -210,7 +1154,7 @@ bool Chip8Processor::HandleInstruction(uint16_t instruction)
 
         case 2:
         {
-            return Call(instruction & 0x0FFF);
+            return Call<Hooks>(instruction & 0x0FFF);
         }
         break;
 
@@ -323,13 +1267,13 @@ bool Chip8Processor::HandleInstruction(uint16_t instruction)
 
                 case 0xF033:
                 {
-                    return StoreBCD(xRegister);
+                    return StoreBCD<Hooks>(xRegister);
                 }
                 break;
 
                 case 0xF055:
                 {
-                    return StoreRegs(xRegister);
+                    return StoreRegs<Hooks>(xRegister);
                 }
                 break;
 
@@ -342,7 +1286,7 @@ bool Chip8Processor::HandleInstruction(uint16_t instruction)
         }
         break;
     }
-    LOG("No instruction handled");
+    LOG_ERROR("No instruction handled");
     return false;
 }
 
@@ -369,11 +1313,14 @@ bool Chip8Processor::Jump(uint16_t address)
     return true;
 }
 
+template <typename Hooks>
 bool Chip8Processor::Call(uint16_t address)
 {
     LOG_RED("%s: %x", __FUNCTION__, address);
     _sp -= 2;
     *((uint16_t*)(_RAM + _sp)) = _pc;
+    InvalidateRange(_sp, 2);
+    Hooks::OnMemoryWrite(*this, _sp, 2);
     _pc = address;
     return (_sp >= (Chip8Processor::STACK_OFFSET - (2 * STACK_DEPTH)));
 }
@@ -381,11 +1328,11 @@ bool Chip8Processor::Call(uint16_t address)
 bool Chip8Processor::SkipValue(uint8_t xRegister, uint8_t value, bool ifEqual)
 {
     LOG_RED("%s: V%u, %u, %s", __FUNCTION__, xRegister, value, ifEqual ? "true" : "false");
-    LOG("v%d = %d", xRegister, _v[xRegister]);
+    LOG_TRACE("v%d = %d", xRegister, _v[xRegister]);
     bool isEqual = (_v[xRegister] == value);
     if (isEqual == ifEqual)
     {
-        LOG("skipping");
+        LOG_TRACE("skipping");
         _pc += 2;
     }
     return true;
@@ -500,9 +1447,18 @@ bool Chip8Processor::SetIRegister(uint16_t value)
 bool Chip8Processor::SetRandom(uint8_t xRegister, uint8_t mask)
 {
     LOG_RED("%s: V%u, %x", __FUNCTION__, xRegister, mask);
-    std::default_random_engine randEng(_rand());
-    std::uniform_int_distribution<int> uniformDist(0, 255);
-    uint8_t rnd = uniformDist(randEng);
+    uint8_t rnd;
+    if ((_replayer == NULL) || !_replayer->NextRandom(_cycles, rnd))
+    {
+        _randomState ^= _randomState << 13;
+        _randomState ^= _randomState >> 17;
+        _randomState ^= _randomState << 5;
+        rnd = _randomState >> 24;
+    }
+    if (_recorder != NULL)
+    {
+        _recorder->RecordRandom(_cycles, rnd);
+    }
     _v[xRegister] = rnd & mask;
     return true;
 }
@@ -512,7 +1468,7 @@ bool Chip8Processor::DrawSprite(uint8_t xRegister, uint8_t yRegister, uint8_t si
     LOG_RED("%s: V%u=%d, V%u=%d, I=%u, %u", __FUNCTION__, xRegister, _v[xRegister], yRegister, _v[yRegister], _I, sizeInBytes);
     if (sizeInBytes > 15)
     {
-        LOG("Size too big!");
+        LOG_ERROR("Size too big!");
         return false;
     }
     _v[15] = 0;  // Assume no pixels are flipped
@@ -520,23 +1476,20 @@ bool Chip8Processor::DrawSprite(uint8_t xRegister, uint8_t yRegister, uint8_t si
     uint8_t x = _v[xRegister];
     uint8_t y = _v[yRegister];
 
-    for (uint8_t i = 0; i < sizeInBytes; i++)
+    const uint8_t* sprite = _RAM + _I;
+    uint8_t wrapped[15];
+    if (_I + sizeInBytes > RAM_SIZE)
     {
-        uint8_t mask = 0x80;
-        uint8_t row = _RAM[_I + i];
-        for (uint8_t xPos = 0; xPos < 8; xPos++)
+        for (uint8_t i = 0; i < sizeInBytes; i++)
         {
-            bool shouldFlip = ((row & mask) != 0);
-            if (shouldFlip)
-            {
-                if (_display->FlipPixel(x + xPos, y))
-                {
-                    _v[15] = 1;  // Set VF if a set pixel was unset
-                }
-            }
-            mask >>= 1;
+            wrapped[i] = _RAM[(_I + i) & (RAM_SIZE - 1)];
         }
-        y++;
+        sprite = wrapped;
+    }
+
+    if (_display->DrawSprite(x, y, sprite, sizeInBytes))
+    {
+        _v[15] = 1;  // Set VF if a set pixel was unset
     }
     return true;
 }
@@ -544,7 +1497,15 @@ bool Chip8Processor::DrawSprite(uint8_t xRegister, uint8_t yRegister, uint8_t si
 bool Chip8Processor::SkipKeyPress(uint8_t xRegister, bool ifIsPressed)
 {
     LOG_RED("%s: V%u, %s", __FUNCTION__, xRegister, ifIsPressed ? "true":"false");
-    bool keyIsPressed = _keyboard->IsKeyDown(_v[xRegister]);
+    bool keyIsPressed;
+    if ((_replayer == NULL) || !_replayer->NextKeyDown(_cycles, keyIsPressed))
+    {
+        keyIsPressed = _keyboard->IsKeyDown(_v[xRegister]);
+    }
+    if (_recorder != NULL)
+    {
+        _recorder->RecordKeyDown(_cycles, keyIsPressed);
+    }
     if (keyIsPressed == ifIsPressed)
     {
         _pc += 2;
@@ -556,16 +1517,39 @@ bool Chip8Processor::StoreDelayTimer(uint8_t xRegister)
 {
     LOG_RED("%s: V%u", __FUNCTION__, xRegister);
     _v[xRegister] = _delayTimer;
-    LOG("DelayTimer = %d", _delayTimer);
+    LOG_TRACE("DelayTimer = %d", _delayTimer);
     return true;
 }
 
 bool Chip8Processor::WaitAndStoreKey(uint8_t xRegister)
 {
     LOG_RED("%s: V%u", __FUNCTION__, xRegister);
-    do {
-        _v[xRegister] = _keyboard->WaitForKey();
-    } while ((_v[xRegister] != 0x10) && _run);
+    uint8_t key;
+    if ((_replayer == NULL) || !_replayer->NextWaitKey(_cycles, key))
+    {
+        if (!_keyWaitStarted)
+        {
+            _keyboard->BeginKeyWait();
+        }
+        key = _keyboard->GetKeyPress();
+    }
+    if (_recorder != NULL)
+    {
+        _recorder->RecordWaitKey(_cycles, key);
+    }
+
+    if (key >= Keyboard::NUM_KEYS)
+    {
+        // Nothing pressed, end the frame and try again on the next one so
+        // the timers keep running while the program waits
+        _pc -= 2;
+        _waitingForKey = true;
+        _keyWaitStarted = true;
+        return true;
+    }
+    _waitingForKey = false;
+    _keyWaitStarted = false;
+    _v[xRegister] = key;
 
     return true;
 }
@@ -573,22 +1557,24 @@ bool Chip8Processor::WaitAndStoreKey(uint8_t xRegister)
 bool Chip8Processor::SetDelayTimer(uint8_t xRegister)
 {
     LOG_RED("%s: V%u", __FUNCTION__, xRegister);
-    _timerLock.lock();
     _delayTimer = _v[xRegister];
-    _timerLock.unlock();
     return true;
 }
 
 bool Chip8Processor::SetSoundTimer(uint8_t xRegister)
 {
     LOG_RED("%s: V%u", __FUNCTION__, xRegister);
-    _timerLock.lock();
     _soundTimer = _v[xRegister];
+    _beeper->Advance(_cycles, _instructionsPerFrame);
     if (_soundTimer > 0)
     {
         _beeper->StartBeeping();
     }
-    _timerLock.unlock();
+    else
+    {
+        // Zero cuts a running tone short
+        _beeper->StopBeeping();
+    }
     return true;
 }
 
@@ -606,6 +1592,7 @@ bool Chip8Processor::SetIToChar(uint8_t xRegister)
     return true;
 }
 
+template <typename Hooks>
 bool Chip8Processor::StoreBCD(uint8_t xRegister)
 {
     LOG_RED("%s: V%u", __FUNCTION__, xRegister);
@@ -621,9 +1608,12 @@ bool Chip8Processor::StoreBCD(uint8_t xRegister)
 
     // Least significant digit
     _RAM[_I + 2] = value;
+    InvalidateRange(_I, 3);
+    Hooks::OnMemoryWrite(*this, _I, 3);
     return true;
 }
 
+template <typename Hooks>
 bool Chip8Processor::StoreRegs(uint8_t xRegister)
 {
     LOG_RED("%s: V%u", __FUNCTION__, xRegister);
@@ -631,6 +1621,8 @@ bool Chip8Processor::StoreRegs(uint8_t xRegister)
     {
         _RAM[_I + i] = _v[i];
     }
+    InvalidateRange(_I, xRegister + 1);
+    Hooks::OnMemoryWrite(*this, _I, xRegister + 1);
     return true;
 }
 
@@ -644,5 +1636,131 @@ bool Chip8Processor::FillRegs(uint8_t xRegister)
     return true;
 }
 
+// Decoded instruction handlers
+bool Chip8Processor::ExecInvalid(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    LOG_ERROR("No instruction handled");
+    return false;
+}
+
+bool Chip8Processor::ExecClearScreen(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.ClearScreen();
+}
+
+bool Chip8Processor::ExecReturn(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.Return();
+}
+
+bool Chip8Processor::ExecJump(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.Jump(op.address);
+}
+
+bool Chip8Processor::ExecJumpOffset(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.Jump(op.address + cpu._v[0]);
+}
+
+bool Chip8Processor::ExecCall(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.Call(op.address);
+}
+
+bool Chip8Processor::ExecSkipValue(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.SkipValue(op.x, op.value, op.flag);
+}
+
+bool Chip8Processor::ExecSkipXY(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.SkipXY(op.x, op.y, op.flag);
+}
+
+bool Chip8Processor::ExecSetByValue(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.SetByValue(op.x, op.value);
+}
+
+bool Chip8Processor::ExecAddToRegister(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.AddToRegister(op.x, op.value);
+}
+
+bool Chip8Processor::ExecMath(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.Math(op.x, op.y, (Chip8Processor::MathCode)op.value);
+}
+
+bool Chip8Processor::ExecSetIRegister(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.SetIRegister(op.address);
+}
+
+bool Chip8Processor::ExecSetRandom(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.SetRandom(op.x, op.value);
+}
+
+bool Chip8Processor::ExecDrawSprite(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.DrawSprite(op.x, op.y, op.value);
+}
+
+bool Chip8Processor::ExecSkipKeyPress(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.SkipKeyPress(op.x, op.flag);
+}
+
+bool Chip8Processor::ExecStoreDelayTimer(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.StoreDelayTimer(op.x);
+}
+
+bool Chip8Processor::ExecWaitAndStoreKey(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.WaitAndStoreKey(op.x);
+}
+
+bool Chip8Processor::ExecSetDelayTimer(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.SetDelayTimer(op.x);
+}
+
+bool Chip8Processor::ExecSetSoundTimer(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.SetSoundTimer(op.x);
+}
+
+bool Chip8Processor::ExecAddToI(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.AddToI(op.x);
+}
+
+bool Chip8Processor::ExecSetIToChar(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.SetIToChar(op.x);
+}
+
+bool Chip8Processor::ExecStoreBCD(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.StoreBCD(op.x);
+}
+
+bool Chip8Processor::ExecStoreRegs(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.StoreRegs(op.x);
+}
+
+bool Chip8Processor::ExecFillRegs(Chip8Processor& cpu, const DecodedInstruction& op)
+{
+    return cpu.FillRegs(op.x);
+}
+
+// The compiled ROMs call these through StaticContext
+template bool Chip8Processor::Call<NoHooks>(uint16_t address);
+template bool Chip8Processor::StoreBCD<NoHooks>(uint8_t xRegister);
+template bool Chip8Processor::StoreRegs<NoHooks>(uint8_t xRegister);
 
 }
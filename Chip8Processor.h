@@ -4,22 +4,42 @@
 #include <stdint.h>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <random>
 #include <vector>
 #include <bitset>
+#include "SpscQueue.h"
 
 namespace chip8
 {
     class Keyboard;
     class Display;
     class Beeper;
+    class Recompiler;
+    class StaticProgram;
+    class StaticContext;
+    class InputRecorder;
+    class InputReplayer;
+    class Profiler;
+    class Debugger;
+    class FrameSink;
+    struct NoHooks;
+    struct DebugHooks;
+    struct Chip8State;
+    struct RomView;
 
 class Chip8Processor
 {
+    friend class StaticContext;
+
     static const uint16_t RAM_SIZE      = 0x1000;  // 4k
     static const uint16_t ROM_OFFSET    = 0x200;
     static const uint16_t STACK_OFFSET  = 0xF00;
     static const uint8_t  STACK_DEPTH   = 16;
+    static const uint16_t FRAME_RATE    = 60;     // Hz
+    static const uint8_t  MAX_IDLE_LOOP = 8;      // Instructions
+    static const uint32_t COMMAND_QUEUE_SIZE = 64;
 
     enum MathCode
     {
@@ -33,9 +53,60 @@ class Chip8Processor
         MATH_MINUS  = 7,
         MATH_SL     = 14
     };
+
+    struct DecodedInstruction;
+    typedef bool (*DecodedHandler)(Chip8Processor& cpu, const DecodedInstruction& op);
+
+    // An instruction with its operands already extracted
+    struct DecodedInstruction
+    {
+        DecodedHandler  handler;    // NULL until the address is decoded
+        uint16_t        address;    // nnn
+        uint8_t         x;
+        uint8_t         y;
+        uint8_t         value;      // kk, n or the math code
+        bool            flag;       // Skip/key sense
+    };
 public:
+    enum ExecutionMode
+    {
+        EXEC_INTERPRETER    = 0,    // Decode every fetch with the switch
+        EXEC_PREDECODED     = 1,    // Dispatch through the decoded instruction cache
+        EXEC_RECOMPILER     = 2,    // Run translated x86-64 blocks, predecoded otherwise
+        EXEC_STATIC         = 3     // Run ahead-of-time compiled blocks, predecoded otherwise
+    };
+
+    enum CommandType
+    {
+        COMMAND_NONE        = 0,
+        COMMAND_PAUSE       = 1,
+        COMMAND_RESUME      = 2,
+        COMMAND_STEP        = 3,
+        COMMAND_RUN_UNTIL   = 4,
+        COMMAND_STOP        = 5,
+        COMMAND_BREAK       = 6     // Not a command, sent with sequence 0 when the debugger stops
+    };
+
+    // Sent back by the execution thread once a command has taken effect
+    struct Acknowledgement
+    {
+        uint32_t    sequence;   // As returned when the command was sent
+        uint8_t     command;    // CommandType
+        bool        completed;  // False if a later command cut a step or run-until short
+        bool        paused;
+        uint16_t    pc;
+        uint64_t    cycles;
+    };
+
+    // ~2000 instructions/s, the rate of the old 500 us per instruction pacing
+    static const uint16_t DEFAULT_INSTRUCTIONS_PER_FRAME = 33;
+
     /**
-     * Constructor
+     * Constructor.  The backends are not owned by the processor.  Pass
+     * NullDisplay, ScriptedKeyboard and NullBeeper to run without a terminal.
+     * @param keyboard The keypad backend
+     * @param display The screen backend
+     * @param beeper The sound backend
      */
     Chip8Processor(Keyboard* keyboard, Display* display, Beeper* beeper);
 
@@ -44,6 +115,13 @@ public:
      */
     virtual ~Chip8Processor();
 
+    /**
+     * The command queues are cache line aligned, which plain new does not
+     * honour before C++17
+     */
+    static void* operator new(size_t size);
+    static void operator delete(void* memory);
+
     /**
      * Loads a ROM from a buffer and places it into RAM
      * @param src The address of the ROM
@@ -52,6 +130,14 @@ public:
      */
     bool LoadRom(const uint8_t* src, uint16_t length);
 
+    /**
+     * Loads a ROM straight out of a mapped RomPack.  Its hash selects the
+     * ahead-of-time compiled code used by EXEC_STATIC.
+     * @param rom The ROM
+     * @return Returns true if the ROM was successfully loaded into memory
+     */
+    bool LoadRom(const RomView& rom);
+
     /**
      * Resets the internal state of the processor.  All registers are zeroed out,
      * except the PC which is set to ROM_OFFSET.  All timers are reset and paused.
@@ -60,12 +146,63 @@ public:
     bool Reset();
 
     /**
-     * Begins execution at the current PC.  Reset should be called first
-     * to initialize all values.
+     * Begins execution at the current PC on a new thread.  Reset should be
+     * called first to initialize all values.
+     *
+     * Run, Stop and the commands below form the control plane.  They must
+     * all be called from the same host thread: commands travel to the
+     * execution thread over a lock-free queue that it checks once per
+     * frame, and each one is acknowledged on a queue going back.
      * @return Returns true if the processor is started
      */
     bool Run();
 
+    /**
+     * Stops executing at the end of the current frame
+     * @return The command sequence number, 0 if the queue is full
+     */
+    uint32_t Pause();
+
+    /**
+     * Continues after Pause, Step or RunUntil
+     * @return The command sequence number, 0 if the queue is full
+     */
+    uint32_t Resume();
+
+    /**
+     * Executes a number of instructions and pauses.  It is acknowledged
+     * when the last one has run.  Frames still end every
+     * instructionsPerFrame instructions, so stepping leaves the processor
+     * exactly where running would have.
+     * @param count The number of instructions
+     * @return The command sequence number, 0 if the queue is full
+     */
+    uint32_t StepInstructions(uint32_t count);
+
+    /**
+     * Executes until the PC reaches an address, at least one instruction,
+     * and pauses.  It is acknowledged when the address is reached.
+     * @param address The address to stop at
+     * @return The command sequence number, 0 if the queue is full
+     */
+    uint32_t RunUntil(uint16_t address);
+
+    /**
+     * Returns the next acknowledgement without blocking
+     * @param ack Receives the acknowledgement
+     * @return False if there is none
+     */
+    bool PollAcknowledgement(Acknowledgement& ack);
+
+    /**
+     * Waits for the acknowledgement of a command, dropping older ones
+     * @param sequence The command sequence number
+     * @param ack Receives the acknowledgement
+     * @param timeoutUs How long to wait in microseconds
+     * @return False on timeout
+     */
+    bool WaitForAcknowledgement(uint32_t sequence, Acknowledgement& ack, uint32_t timeoutUs);
+
     /**
      * Executes the instruction at PC and increments the PC accordingly
      * @return True if the instruction was successfully executed
@@ -73,13 +210,144 @@ public:
     bool Step();
 
     /**
-     * Stops program execution
-     * @return Returns true if the processor is stopped
+     * Executes one 60 Hz frame worth of instructions back to back, ticks
+     * the delay and sound timers once and presents the frame to the display.
+     * Timers run on emulated time, so they behave the same at any speed.
+     * @return True if every instruction was successfully executed
+     */
+    bool RunFrame();
+
+    /**
+     * Returns the number of instructions executed since the last reset
+     * @return The instruction count
+     */
+    uint64_t GetCycles() const;
+
+    /**
+     * Returns how many of the instructions counted by GetCycles were
+     * skipped by idle loop detection since the last reset
+     * @return The skipped instruction count
+     */
+    uint64_t GetIdleCycles() const;
+
+    /**
+     * Idle loop detection finds loops that spin on Fx07 or the keypad
+     * with nothing else but skips, and jumps over the rest of the frame
+     * instead of running them.  The delay timer and the keys only change
+     * between frames, so the processor ends up in exactly the state it
+     * would have reached.  In real time the frame then sleeps; in turbo
+     * the next frame starts at once.  Loops that poll keys are run in full
+     * while input is recorded or replayed, since every query is an event.
+     * It is on by default.
+     * @param enabled False to run every instruction
+     */
+    void SetIdleSkipping(bool enabled);
+
+    /**
+     * Copies the processor, memory and screen into a snapshot.  Only call
+     * this while the processor is stopped.
+     * @param state The snapshot to fill in
+     */
+    void SaveState(Chip8State& state) const;
+
+    /**
+     * Restores a snapshot taken by SaveState.  Only call this while the
+     * processor is stopped.
+     * @param state The snapshot
+     * @return False if the snapshot is from an incompatible version
+     */
+    bool LoadState(const Chip8State& state);
+
+    /**
+     * Records every key query and random draw from now on
+     * @param recorder The recorder, not owned, or NULL to stop recording
+     */
+    void SetInputRecorder(InputRecorder* recorder);
+
+    /**
+     * Takes key queries and random draws from a recording instead of the
+     * keyboard and the random device, until the recording runs out or
+     * stops matching
+     * @param replayer The replayer, not owned, or NULL for live input
+     */
+    void SetInputReplayer(InputReplayer* replayer);
+
+    /**
+     * Profiles every instruction from now on.  While a profiler is attached
+     * instructions go through the interpreter, so the recompiler and the
+     * predecoded cache are bypassed.
+     * @param profiler The profiler, not owned, or NULL to stop profiling
+     */
+    void SetProfiler(Profiler* profiler);
+
+    /**
+     * Attaches breakpoints, watchpoints and instruction callbacks.  While a
+     * debugger is attached every instruction goes through the interpreter
+     * with DebugHooks, one at a time; the check is made once per frame, so
+     * without one nothing changes.  Attach or detach it, and change its
+     * breakpoints and watchpoints, only while stopped or paused.
+     * @param debugger The debugger, not owned, or NULL to detach it
+     */
+    void SetDebugger(Debugger* debugger);
+
+    /**
+     * Returns the attached debugger
+     * @return The debugger, or NULL
+     */
+    Debugger* GetDebugger() const;
+
+    /**
+     * Hands the screen to a sink at the end of every frame, e.g. a
+     * FrameCapture.  Called on the execution thread.
+     * @param sink The sink, not owned, or NULL for none
+     */
+    void SetFrameSink(FrameSink* sink);
+
+    /**
+     * Seeds the xorshift32 generator behind Cxkk.  Each processor is seeded
+     * once from std::random_device when it is created; Reset leaves the
+     * generator alone.  A BatchEngine lane n seeded with s draws the same
+     * bytes as a processor seeded with s + n.
+     * @param seed The seed, 0 is replaced by a fixed non-zero value
+     */
+    void SetRandomSeed(uint32_t seed);
+
+    /**
+     * Returns the generator state, to save and restore it with SetRandomState
+     * @return The state
+     */
+    uint32_t GetRandomState() const;
+    void SetRandomState(uint32_t state);
+
+    /**
+     * Sets how many instructions are executed per 60 Hz frame
+     * @param count The number of instructions per frame
+     */
+    void SetInstructionsPerFrame(uint16_t count);
+
+    /**
+     * Turbo mode runs frames back to back with no wall-clock pacing
+     * @param turbo True to disable pacing
+     */
+    void SetTurbo(bool turbo);
+
+    /**
+     * Selects how instructions are dispatched.  Only call this while the
+     * processor is stopped.
+     * @param mode The execution mode
+     * @return True if the mode is supported on this host
+     */
+    bool SetExecutionMode(ExecutionMode mode);
+
+    /**
+     * Stops program execution and waits for the execution thread to exit
+     * @return Returns true if the processor is still running
      */
     bool Stop();
 
     /**
-     * Returns true if the processor is currently executing a program
+     * Returns true while the execution thread is alive, paused or not.
+     * It turns false on its own if an instruction fails.
      * @return True if the processor is currently executing a program
      */
     bool IsRunning();
@@ -97,31 +365,94 @@ protected:
     // I register
     uint16_t _I;
 
-    // Timers
+    // Timers, ticked once per frame
     uint16_t _delayTimer;
     uint16_t _soundTimer;
 
+    // Instructions executed since reset, and how many of them were skipped
+    uint64_t _cycles;
+    uint64_t _idleCycles;
+    bool     _idleSkipping;
+
+    // Set when Fx0A found no key, the frame ends and Fx0A runs again
+    bool     _waitingForKey;
+    // Set from the first Fx0A poll that found no key until one is stored
+    bool     _keyWaitStarted;
+
     uint8_t  _RAM[RAM_SIZE];
 
-    // True when execution thread is running
-    bool                _run;
-    std::mutex          _runLock;
-    std::mutex          _timerLock;
+    // One entry per even address, invalidated when the RAM under it is written
+    DecodedInstruction  _decoded[RAM_SIZE / 2];
+    ExecutionMode       _executionMode;
+    Recompiler*         _recompiler;
+    StaticProgram*      _staticProgram;
+    uint64_t            _romHash;
+
+    // Input recording and replay, both optional
+    InputRecorder*      _recorder;
+    InputReplayer*      _replayer;
+    Profiler*           _profiler;
+    Debugger*           _debugger;
+    FrameSink*          _frameSink;
+
+    // Scheduling
+    uint16_t _instructionsPerFrame;
+    bool     _turbo;
+
+    struct Command
+    {
+        uint8_t     type;       // CommandType
+        uint32_t    sequence;
+        uint32_t    count;      // Instructions left to step
+        uint16_t    address;    // Run-until target
+    };
+
+    // Control plane.  The host produces commands and consumes
+    // acknowledgements, the execution thread the other way round.
+    SpscQueue<Command, COMMAND_QUEUE_SIZE>          _commands;
+    SpscQueue<Acknowledgement, COMMAND_QUEUE_SIZE>  _acknowledgements;
+    uint32_t                _nextSequence;      // Host thread only
+    bool                    _paused;            // Execution thread only
+    Command                 _activeCommand;     // Step or run-until in progress
+    uint32_t                _frameProgress;     // Instructions already run this frame
+    std::mutex              _wakeLock;          // Only for sleeping on _wakeCondition
+    std::condition_variable _wakeCondition;
+
+    // True while the execution thread is alive
+    std::atomic<bool>   _run;
     std::thread*        _runThread;
-    std::thread*        _timerThread;
     Keyboard*           _keyboard;
     Display*            _display;
     Beeper*             _beeper;
-    std::random_device  _rand;
+    uint32_t            _randomState;   // xorshift32, never 0
 
+    template <typename Hooks = NoHooks>
     bool HandleInstruction(uint16_t instruction);
+    template <typename Hooks>
+    bool StepWith();
     void ExecutionThread();
-    void TimerThread();
+    uint32_t SendCommand(CommandType type, uint32_t count, uint16_t address);
+    void Wake();
+    bool HandleCommands();
+    void Acknowledge(const Command& command, bool completed);
+    void SleepUntilCommand(const std::chrono::steady_clock::time_point* deadline);
+    bool StepFrame();
+    template <typename Hooks>
+    bool StepFrameWith();
+    void EndFrame();
+    void JoinExecutionThread();
+    bool ProfileStep();
+    void TickTimers();
+    uint32_t SkipIdleLoop(uint32_t budget);
+    uint32_t MeasureIdleLoop(uint16_t head) const;
+    void Decode(uint16_t address, DecodedInstruction& op);
+    void InvalidateRange(uint16_t address, uint16_t length);
 
     // Instructions
     bool ClearScreen();
     bool Return();
     bool Jump(uint16_t address);
+    template <typename Hooks = NoHooks>
     bool Call(uint16_t address);
     bool SkipValue(uint8_t xRegister, uint8_t value, bool ifEqual);
     bool SkipXY(uint8_t xRegister, uint8_t yRegister, bool ifEqual);
@@ -138,9 +469,37 @@ protected:
     bool SetSoundTimer(uint8_t xRegister);
     bool AddToI(uint8_t xRegister);
     bool SetIToChar(uint8_t xRegister);
+    template <typename Hooks = NoHooks>
     bool StoreBCD(uint8_t xRegister);
+    template <typename Hooks = NoHooks>
     bool StoreRegs(uint8_t xRegister);
     bool FillRegs(uint8_t xRegister);
+
+    // Decoded instruction handlers
+    static bool ExecInvalid(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecClearScreen(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecReturn(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecJump(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecJumpOffset(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecCall(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecSkipValue(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecSkipXY(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecSetByValue(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecAddToRegister(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecMath(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecSetIRegister(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecSetRandom(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecDrawSprite(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecSkipKeyPress(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecStoreDelayTimer(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecWaitAndStoreKey(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecSetDelayTimer(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecSetSoundTimer(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecAddToI(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecSetIToChar(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecStoreBCD(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecStoreRegs(Chip8Processor& cpu, const DecodedInstruction& op);
+    static bool ExecFillRegs(Chip8Processor& cpu, const DecodedInstruction& op);
 };
 }
 #endif /* CHIP8PROCESSOR_H_ */
@@ -0,0 +1,45 @@
+#ifndef CHIP8STATE_H_
+#define CHIP8STATE_H_
+
+#include <stdint.h>
+
+namespace chip8
+{
+    /**
+     * Everything needed to resume a processor, laid out as plain data so a
+     * snapshot is a memcpy and a snapshot file can be mapped and used as is.
+     * Bump VERSION whenever the layout changes.
+     */
+    struct Chip8State
+    {
+        static const uint32_t MAGIC     = 0x38504843;   // "CHP8"
+        static const uint32_t VERSION   = 2;
+
+        uint32_t magic;
+        uint32_t version;
+        uint32_t size;          // sizeof(Chip8State) when it was written
+
+        uint8_t  v[16];
+        uint16_t pc;
+        uint16_t sp;
+        uint16_t I;
+        uint16_t delayTimer;
+        uint16_t soundTimer;
+        uint32_t randomState;   // Cxkk generator
+        uint64_t cycles;
+        uint64_t frame[32];     // Display rows, see FrameBuffer
+        uint8_t  ram[0x1000];   // Includes the stack
+
+        /**
+         * Returns true if the header matches this build's layout
+         * @return True if the state can be loaded
+         */
+        bool IsValid() const
+        {
+            return (magic == MAGIC) && (version == VERSION) && (size == sizeof(Chip8State));
+        }
+    };
+
+} /* namespace chip8 */
+
+#endif /* CHIP8STATE_H_ */
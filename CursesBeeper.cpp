@@ -0,0 +1,67 @@
+#include "CursesBeeper.h"
+#include <chrono>
+#include <ncurses.h>
+
+#define LOG_TAG "CursesBeeper"
+#include "log.h"
+
+namespace chip8
+{
+
+CursesBeeper::CursesBeeper()
+: _isBeeping(false)
+, _isAlive(true)
+{
+    _beepThread = new std::thread(&CursesBeeper::BeepThread, this);
+}
+
+CursesBeeper::~CursesBeeper()
+{
+    _beepLock.lock();
+    _isAlive = false;
+    _beepLock.unlock();
+    _beepCondition.notify_one();
+    _beepThread->join();
+    delete _beepThread;
+}
+
+bool CursesBeeper::StartBeeping()
+{
+    _beepLock.lock();
+    bool started = !_isBeeping;
+    _isBeeping = true;
+    _beepLock.unlock();
+    if (started)
+    {
+        _beepCondition.notify_one();
+    }
+    return true;
+}
+
+bool CursesBeeper::StopBeeping()
+{
+    _beepLock.lock();
+    _isBeeping = false;
+    _beepLock.unlock();
+    return true;
+}
+
+void CursesBeeper::BeepThread()
+{
+    const std::chrono::milliseconds period(50);
+    std::unique_lock<std::mutex> lock(_beepLock);
+    while (_isAlive)
+    {
+        if (!_isBeeping)
+        {
+            _beepCondition.wait(lock);
+            continue;
+        }
+
+        lock.unlock();
+        beep();
+        lock.lock();
+        _beepCondition.wait_for(lock, period);
+    }
+}
+} /* namespace chip8 */
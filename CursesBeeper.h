@@ -0,0 +1,35 @@
+#ifndef CURSESBEEPER_H_
+#define CURSESBEEPER_H_
+
+#include "Beeper.h"
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+namespace chip8
+{
+    /**
+     * Beeper backend that rings the terminal bell.  The bell thread sleeps
+     * until a tone starts, so it costs nothing while the program is silent.
+     */
+    class CursesBeeper : public Beeper
+    {
+    public:
+        CursesBeeper();
+        virtual ~CursesBeeper();
+
+        virtual bool StartBeeping();
+        virtual bool StopBeeping();
+        void BeepThread();
+
+    protected:
+        std::mutex              _beepLock;
+        std::condition_variable _beepCondition;
+        bool                    _isBeeping;
+        std::thread*            _beepThread;
+        bool                    _isAlive;
+    };
+
+} /* namespace chip8 */
+
+#endif /* CURSESBEEPER_H_ */
@@ -0,0 +1,110 @@
+#include "CursesDisplay.h"
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#define LOG_TAG "CursesDisplay"
+#include "log.h"
+
+namespace chip8
+{
+
+CursesDisplay::CursesDisplay(FILE* output)
+: _writeSlot(0)
+, _readSlot(1)
+, _middle(2)
+, _refreshRun(true)
+{
+    memset(_slots, 0, sizeof(_slots));
+    memset(_drawn, 0, sizeof(_drawn));
+    _screen = newterm(NULL, output, stdin);
+    if (_screen == NULL)
+    {
+        // What initscr would have done
+        LOG_ERROR("Could not open the terminal");
+        exit(-1);
+    }
+    cbreak();
+    noecho();
+    curs_set(0);
+    _win = newwin(DISP_HEIGHT+2, DISP_WIDTH+2, 0, 0);
+    DrawBorder();
+    _refreshThread = new std::thread(&CursesDisplay::RefreshThread, this);
+}
+
+CursesDisplay::~CursesDisplay()
+{
+    _refreshRun = false;
+    _refreshThread->join();
+    delete _refreshThread;
+    endwin();
+    delscreen(_screen);
+}
+
+void CursesDisplay::DrawBorder()
+{
+    wborder(_win, ACS_VLINE, ACS_VLINE, ACS_HLINE, ACS_HLINE, ACS_ULCORNER, ACS_URCORNER, ACS_LLCORNER, ACS_LRCORNER);
+    touchwin(_win);
+    refresh();
+    wrefresh(_win);
+}
+
+void CursesDisplay::Clear()
+{
+    _frame.Clear();
+}
+
+bool CursesDisplay::DrawSprite(uint8_t x, uint8_t y, const uint8_t* sprite, uint8_t rows)
+{
+    LOG_TRACE("%s", __FUNCTION__);
+    return _frame.DrawSprite(x, y, sprite, rows);
+}
+
+void CursesDisplay::Present()
+{
+    memcpy(_slots[_writeSlot], _frame.GetRows(), sizeof(_slots[_writeSlot]));
+    _writeSlot = _middle.exchange(_writeSlot | FRESH_FRAME, std::memory_order_acq_rel) & SLOT_MASK;
+}
+
+const FrameBuffer& CursesDisplay::GetFrame() const
+{
+    return _frame;
+}
+
+void CursesDisplay::SetFrame(const FrameBuffer& frame)
+{
+    _frame = frame;
+}
+
+void CursesDisplay::Render(const uint64_t* rows)
+{
+    for (uint8_t y = 0; y < DISP_HEIGHT; y++)
+    {
+        uint64_t changed = rows[y] ^ _drawn[y];
+        while (changed != 0)
+        {
+            uint8_t x = __builtin_clzll(changed);
+            bool isSet = ((rows[y] >> (DISP_WIDTH - 1 - x)) & 1) != 0;
+            mvwaddch(_win, y+1, x+1, isSet ? '\xFE' : ' ');
+            changed &= ~(1ULL << (DISP_WIDTH - 1 - x));
+        }
+        _drawn[y] = rows[y];
+    }
+}
+
+void CursesDisplay::RefreshThread()
+{
+    while (_refreshRun)
+    {
+        std::chrono::milliseconds period(40);
+        std::this_thread::sleep_for(period);
+        if ((_middle.load(std::memory_order_relaxed) & FRESH_FRAME) == 0)
+        {
+            continue;
+        }
+        _readSlot = _middle.exchange(_readSlot, std::memory_order_acq_rel) & SLOT_MASK;
+        Render(_slots[_readSlot]);
+        wrefresh(_win);
+    }
+}
+} /* namespace chip8 */
@@ -0,0 +1,63 @@
+#ifndef CURSESDISPLAY_H_
+#define CURSESDISPLAY_H_
+
+#include "Display.h"
+#include "FrameBuffer.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+#include <ncurses.h>
+
+namespace chip8
+{
+    /**
+     * Display backend that draws the screen in an ncurses window.
+     *
+     * The processor draws into a back buffer that only it touches.
+     * Present() copies it into a free slot of a triple buffer and swaps
+     * that slot in as the newest frame.  The render thread swaps the newest
+     * frame out, compares it with the last frame it drew, and only sends
+     * the cells that changed.  All curses calls after construction happen
+     * on the render thread.
+     */
+    class CursesDisplay : public Display
+    {
+    public:
+        /**
+         * @param output Where to draw the terminal, stderr when stdout carries
+         *               something else such as a WAV stream
+         */
+        CursesDisplay(FILE* output = stdout);
+        virtual ~CursesDisplay();
+
+        virtual void Clear();
+        virtual bool DrawSprite(uint8_t x, uint8_t y, const uint8_t* sprite, uint8_t rows);
+        virtual void Present();
+        virtual const FrameBuffer& GetFrame() const;
+        virtual void SetFrame(const FrameBuffer& frame);
+
+    protected:
+        static const uint8_t  FRESH_FRAME = 0x4;   // Set in _middle when it holds an undrawn frame
+        static const uint8_t  SLOT_MASK   = 0x3;
+
+        void DrawBorder();
+        void RefreshThread();
+        void Render(const uint64_t* rows);
+
+        FrameBuffer             _frame;                     // Back buffer, processor thread only
+        uint64_t                _slots[3][DISP_HEIGHT];
+        uint8_t                 _writeSlot;                 // Owned by the processor thread
+        uint8_t                 _readSlot;                  // Owned by the render thread
+        std::atomic<uint8_t>    _middle;                    // Slot handed between the two
+        uint64_t                _drawn[DISP_HEIGHT];        // What the terminal shows
+        SCREEN*                 _screen;
+        WINDOW*                 _win;
+        std::atomic<bool>       _refreshRun;
+        std::thread*            _refreshThread;
+
+    };
+
+} /* namespace chip8 */
+
+#endif /* CURSESDISPLAY_H_ */
@@ -0,0 +1,118 @@
+#include "Debugger.h"
+
+#define LOG_TAG "Debugger"
+#include "log.h"
+
+namespace chip8
+{
+
+Debugger::Debugger()
+: _breakReason(BREAK_NONE)
+, _breakAddress(0)
+, _resumeAddress(NO_ADDRESS)
+{
+}
+
+Debugger::~Debugger()
+{
+}
+
+void Debugger::AddBreakpoint(uint16_t address)
+{
+    _breakpoints.set(address % ADDRESS_COUNT);
+}
+
+void Debugger::RemoveBreakpoint(uint16_t address)
+{
+    _breakpoints.reset(address % ADDRESS_COUNT);
+}
+
+void Debugger::AddWatchpoint(uint16_t address, uint16_t length)
+{
+    Watchpoint watchpoint = { address, length };
+    _watchpoints.push_back(watchpoint);
+}
+
+void Debugger::RemoveWatchpoint(uint16_t address, uint16_t length)
+{
+    for (std::vector<Watchpoint>::iterator it = _watchpoints.begin(); it != _watchpoints.end(); ++it)
+    {
+        if ((it->address == address) && (it->length == length))
+        {
+            _watchpoints.erase(it);
+            return;
+        }
+    }
+}
+
+void Debugger::Clear()
+{
+    _breakpoints.reset();
+    _watchpoints.clear();
+    _resumeAddress = NO_ADDRESS;
+}
+
+void Debugger::SetInstructionCallback(const InstructionCallback& callback)
+{
+    _instructionCallback = callback;
+}
+
+void Debugger::SetWatchCallback(const WatchCallback& callback)
+{
+    _watchCallback = callback;
+}
+
+Debugger::BreakReason Debugger::TakeBreak()
+{
+    BreakReason reason = _breakReason;
+    _breakReason = BREAK_NONE;
+    return reason;
+}
+
+uint16_t Debugger::GetBreakAddress() const
+{
+    return _breakAddress;
+}
+
+bool Debugger::BeforeInstruction(Chip8Processor& cpu, uint16_t pc, uint16_t instruction)
+{
+    // Stopping on a breakpoint leaves the PC on it, so let the next
+    // instruction through or the processor could never get past
+    if (_breakpoints[pc % ADDRESS_COUNT] && (pc != _resumeAddress))
+    {
+        LOG("Breakpoint at 0x%03x", pc);
+        _breakReason = BREAK_BREAKPOINT;
+        _breakAddress = pc;
+        _resumeAddress = pc;
+        return false;
+    }
+    _resumeAddress = NO_ADDRESS;
+
+    if (_instructionCallback)
+    {
+        _instructionCallback(cpu, pc, instruction);
+    }
+    return true;
+}
+
+void Debugger::OnMemoryWrite(Chip8Processor& cpu, uint16_t address, uint16_t length)
+{
+    uint32_t end = (uint32_t)address + length;
+    for (size_t i = 0; i < _watchpoints.size(); i++)
+    {
+        const Watchpoint& watchpoint = _watchpoints[i];
+        if ((address < (uint32_t)watchpoint.address + watchpoint.length) && (watchpoint.address < end))
+        {
+            LOG("Write to 0x%03x-0x%03x hit a watchpoint", address, end - 1);
+            _breakReason = BREAK_WATCHPOINT;
+            _breakAddress = address;
+            if (_watchCallback)
+            {
+                _watchCallback(cpu, address, length);
+            }
+            return;
+        }
+    }
+}
+
+} /* namespace chip8 */
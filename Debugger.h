@@ -0,0 +1,117 @@
+#ifndef DEBUGGER_H_
+#define DEBUGGER_H_
+
+#include <stdint.h>
+#include <bitset>
+#include <functional>
+#include <vector>
+
+namespace chip8
+{
+    class Chip8Processor;
+
+    /**
+     * PC breakpoints, RAM write watchpoints and per-instruction callbacks.
+     *
+     * While a debugger is attached the processor runs every instruction
+     * through the DebugHooks instantiation of the interpreter; without one
+     * it runs the NoHooks instantiation, which is the normal hot path with
+     * no hook code in it at all.  A breakpoint stops before the instruction
+     * at its address runs, a watchpoint right after the instruction that
+     * wrote into its range.  Either way the frame is left partway done and
+     * the execution thread pauses, sending an Acknowledgement with
+     * COMMAND_BREAK.
+     *
+     * Nothing here is locked: the execution thread reads the breakpoints
+     * and watchpoints without synchronization, so add and remove them only
+     * while the processor is stopped or paused.
+     */
+    class Debugger
+    {
+    public:
+        static const uint16_t   ADDRESS_COUNT = 0x1000;
+
+        enum BreakReason
+        {
+            BREAK_NONE,
+            BREAK_BREAKPOINT,
+            BREAK_WATCHPOINT
+        };
+
+        /**
+         * Called before every instruction, on the execution thread
+         */
+        typedef std::function<void(Chip8Processor& cpu, uint16_t pc, uint16_t instruction)> InstructionCallback;
+
+        /**
+         * Called after every write into a watched range, on the execution thread
+         */
+        typedef std::function<void(Chip8Processor& cpu, uint16_t address, uint16_t length)> WatchCallback;
+
+        Debugger();
+        virtual ~Debugger();
+
+        void AddBreakpoint(uint16_t address);
+        void RemoveBreakpoint(uint16_t address);
+
+        /**
+         * Watches writes by Fx33, Fx55 and the stack pushes of 2nnn
+         * @param address The first address watched
+         * @param length The number of bytes watched
+         */
+        void AddWatchpoint(uint16_t address, uint16_t length);
+        void RemoveWatchpoint(uint16_t address, uint16_t length);
+
+        /**
+         * Removes every breakpoint and watchpoint
+         */
+        void Clear();
+
+        void SetInstructionCallback(const InstructionCallback& callback);
+        void SetWatchCallback(const WatchCallback& callback);
+
+        /**
+         * Returns why the processor last stopped and forgets it
+         * @return The reason, BREAK_NONE if it has not stopped
+         */
+        BreakReason TakeBreak();
+
+        /**
+         * Returns where the last break happened: the breakpoint address, or
+         * the first address written for a watchpoint
+         * @return The address
+         */
+        uint16_t GetBreakAddress() const;
+
+        /**
+         * Hook for DebugHooks before each instruction
+         * @return False to stop before the instruction runs
+         */
+        bool BeforeInstruction(Chip8Processor& cpu, uint16_t pc, uint16_t instruction);
+
+        /**
+         * Hook for DebugHooks after each RAM write
+         */
+        void OnMemoryWrite(Chip8Processor& cpu, uint16_t address, uint16_t length);
+
+    protected:
+        struct Watchpoint
+        {
+            uint16_t    address;
+            uint16_t    length;
+        };
+
+        static const uint32_t   NO_ADDRESS = 0xFFFFFFFF;
+
+        std::bitset<ADDRESS_COUNT>  _breakpoints;
+        std::vector<Watchpoint>     _watchpoints;
+        InstructionCallback         _instructionCallback;
+        WatchCallback               _watchCallback;
+        BreakReason                 _breakReason;
+        uint16_t                    _breakAddress;
+        uint32_t                    _resumeAddress;   // Breakpoint to step over once, after stopping on it
+    };
+
+} /* namespace chip8 */
+
+#endif /* DEBUGGER_H_ */
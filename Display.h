@@ -1,44 +1,56 @@
 #ifndef DISPLAY_H_
 #define DISPLAY_H_
 
+#include "FrameBuffer.h"
 #include <stdint.h>
-#include <bitset>
-#include <thread>
-#include <ncurses.h>
 
 namespace chip8
 {
+    /**
+     * Interface for the 64x32 monochrome screen driven by the processor.
+     * Backends decide where (and whether) the pixels are shown.
+     */
     class Display
     {
+    public:
         static const uint8_t  DISP_WIDTH    = 64;
         static const uint8_t  DISP_HEIGHT   = 32;
 
-    public:
-        Display();
-        virtual ~Display();
+        virtual ~Display() {}
 
         /**
          * Clears the display
          */
-        void Clear();
+        virtual void Clear() = 0;
 
         /**
-         * Flips the value of the pixel at (x,y)  If the pixel was
-         * already set, true is returned.  Otherwise, false
-         * @param x The x coordinate of the pixel to flip
-         * @param y The y coordinate of the pixel to flip
+         * XORs a sprite onto the display, wrapping at the edges.  If any
+         * set pixel was unset, true is returned.  Otherwise, false
+         * @param x The x coordinate of the sprite's left edge
+         * @param y The y coordinate of the sprite's top edge
+         * @param sprite The sprite rows, one byte per row, MSB leftmost
+         * @param rows The number of rows in the sprite
          * @return True if a set pixel was unset
          */
-        bool FlipPixel(uint8_t x, uint8_t y);
+        virtual bool DrawSprite(uint8_t x, uint8_t y, const uint8_t* sprite, uint8_t rows) = 0;
 
-    protected:
-        void DrawBorder();
-        void RefreshThread();
-        std::bitset<DISP_WIDTH> _pixels[DISP_HEIGHT];
-        WINDOW*                 _win;
-        bool                    _refreshRun;
-        std::thread*            _refreshThread;
+        /**
+         * Marks the end of a frame.  Backends that render on their own
+         * thread publish what has been drawn so far.
+         */
+        virtual void Present() {}
 
+        /**
+         * Returns what has been drawn so far
+         * @return The frame buffer
+         */
+        virtual const FrameBuffer& GetFrame() const = 0;
+
+        /**
+         * Replaces the screen contents, e.g. when a saved state is loaded
+         * @param frame The new contents
+         */
+        virtual void SetFrame(const FrameBuffer& frame) = 0;
     };
 
 } /* namespace chip8 */
@@ -0,0 +1,257 @@
+#include "EvdevKeyboard.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+
+#define LOG_TAG "EvdevKeyboard"
+#include "log.h"
+namespace chip8
+{
+
+namespace
+{
+    const uint16_t keyMap[] =
+    {
+        KEY_X, // 0
+        KEY_1, // 1
+        KEY_2, // 2
+        KEY_3, // 3
+        KEY_Q, // 4
+        KEY_W, // 5
+        KEY_E, // 6
+        KEY_A, // 7
+        KEY_S, // 8
+        KEY_D, // 9
+        KEY_Z, // 10
+        KEY_C, // 11
+        KEY_4, // 12
+        KEY_R, // 13
+        KEY_F, // 14
+        KEY_V, // 15
+    };
+}
+
+const char* const EvdevKeyboard::DEFAULT_DEVICE = "/dev/input/by-path/platform-i8042-serio-0-event-kbd";
+
+EvdevKeyboard::EvdevKeyboard(const std::string& devicePath)
+: _devicePath(devicePath)
+, _fd(-1)
+, _keyStates(0)
+, _keyPresses(0)
+, _waitCancelled(false)
+, _readerThread(NULL)
+{
+    _wakePipe[0] = -1;
+    _wakePipe[1] = -1;
+
+    _fd = open(_devicePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (_fd < 0)
+    {
+        LOG_ERROR("Could not open %s: %s", _devicePath.c_str(), strerror(errno));
+        return;
+    }
+
+    // Pick up keys that are already held down
+    char key_map[KEY_MAX/8 + 1];
+    memset(key_map, 0, sizeof(key_map));
+    if (ioctl(_fd, EVIOCGKEY(sizeof(key_map)), key_map) >= 0)
+    {
+        for (uint8_t key = 0; key < NUM_KEYS; key++)
+        {
+            SetKey(keyMap[key], (key_map[keyMap[key]/8] & (1 << (keyMap[key] % 8))) != 0);
+        }
+    }
+
+    if (pipe(_wakePipe) != 0)
+    {
+        LOG_ERROR("Could not create wake pipe");
+        close(_fd);
+        _fd = -1;
+        return;
+    }
+    _readerThread = new std::thread(&EvdevKeyboard::ReaderThread, this);
+}
+
+EvdevKeyboard::~EvdevKeyboard()
+{
+    if (_readerThread != NULL)
+    {
+        char stop = 0;
+        if (write(_wakePipe[1], &stop, 1) != 1)
+        {
+            LOG_ERROR("Could not wake the reader thread");
+        }
+        _readerThread->join();
+        delete _readerThread;
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (_wakePipe[i] >= 0)
+        {
+            close(_wakePipe[i]);
+        }
+    }
+    if (_fd >= 0)
+    {
+        close(_fd);
+    }
+}
+
+bool EvdevKeyboard::IsOpen() const
+{
+    return (_fd >= 0);
+}
+
+bool EvdevKeyboard::IsKeyDown(uint8_t key)
+{
+    if (key >= NUM_KEYS)
+    {
+        return false;
+    }
+    return (_keyStates.load(std::memory_order_relaxed) & (1 << key)) != 0;
+}
+
+uint8_t EvdevKeyboard::GetKeyPress()
+{
+    uint16_t presses = _keyPresses.load(std::memory_order_relaxed);
+    for (uint8_t key = 0; key < NUM_KEYS; key++)
+    {
+        if ((presses & (1 << key)) != 0)
+        {
+            _keyPresses.fetch_and(~(1 << key), std::memory_order_relaxed);
+            return key;
+        }
+    }
+    return NO_KEY;
+}
+
+void EvdevKeyboard::BeginKeyWait()
+{
+    // The reader thread latches every press, including the ones a game
+    // polled with Ex9E/ExA1 long ago
+    _keyPresses.store(0, std::memory_order_relaxed);
+}
+
+bool EvdevKeyboard::WaitForKeyPress()
+{
+    std::unique_lock<std::mutex> lock(_waitLock);
+    while ((_keyPresses.load(std::memory_order_relaxed) == 0) && !_waitCancelled)
+    {
+        _waitCondition.wait(lock);
+    }
+    return !_waitCancelled;
+}
+
+void EvdevKeyboard::CancelWait(bool cancelled)
+{
+    std::lock_guard<std::mutex> lock(_waitLock);
+    _waitCancelled = cancelled;
+    _waitCondition.notify_all();
+}
+
+void EvdevKeyboard::SetKey(uint16_t code, bool isDown)
+{
+    for (uint8_t key = 0; key < NUM_KEYS; key++)
+    {
+        if (keyMap[key] == code)
+        {
+            if (isDown)
+            {
+                _keyStates.fetch_or(1 << key, std::memory_order_relaxed);
+            }
+            else
+            {
+                _keyStates.fetch_and(~(1 << key), std::memory_order_relaxed);
+            }
+            return;
+        }
+    }
+}
+
+void EvdevKeyboard::OnKeyPress(uint16_t code)
+{
+    for (uint8_t key = 0; key < NUM_KEYS; key++)
+    {
+        if (keyMap[key] == code)
+        {
+            // Taking the lock orders the press before a waiter's check
+            _keyPresses.fetch_or(1 << key, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(_waitLock);
+            _waitCondition.notify_all();
+            return;
+        }
+    }
+}
+
+void EvdevKeyboard::ReaderThread()
+{
+    LOG("Reading %s", _devicePath.c_str());
+    pollfd fds[2];
+    fds[0].fd = _fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = _wakePipe[0];
+    fds[1].events = POLLIN;
+
+    while (true)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            LOG_ERROR("poll failed: %s", strerror(errno));
+            return;
+        }
+
+        if (fds[1].revents != 0)
+        {
+            return;
+        }
+
+        if ((fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0)
+        {
+            LOG_ERROR("Lost %s", _devicePath.c_str());
+            _keyStates = 0;
+            return;
+        }
+
+        input_event events[64];
+        ssize_t length = read(_fd, events, sizeof(events));
+        if (length < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+            {
+                continue;
+            }
+            LOG_ERROR("read failed: %s", strerror(errno));
+            return;
+        }
+        if (length == 0)
+        {
+            LOG_ERROR("Lost %s", _devicePath.c_str());
+            _keyStates = 0;
+            return;
+        }
+
+        for (size_t i = 0; i < (size_t)length / sizeof(input_event); i++)
+        {
+            // value is 0 for release, 1 for press and 2 for autorepeat
+            if (events[i].type == EV_KEY)
+            {
+                SetKey(events[i].code, events[i].value != 0);
+                if (events[i].value == 1)
+                {
+                    OnKeyPress(events[i].code);
+                }
+            }
+        }
+    }
+}
+} /* namespace chip8 */
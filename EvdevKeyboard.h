@@ -0,0 +1,78 @@
+#ifndef EVDEVKEYBOARD_H_
+#define EVDEVKEYBOARD_H_
+
+#include "Keyboard.h"
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <thread>
+
+namespace chip8
+{
+    /**
+     * Keyboard backend that reads a Linux input device.  The device is
+     * opened once and a reader thread turns its key events into a 16 bit
+     * mask of CHIP-8 key states, so a key query is a single atomic load.
+     * Presses are also collected in a second mask for Fx0A, and a thread
+     * waiting for one sleeps on a condition variable.
+     */
+    class EvdevKeyboard : public Keyboard
+    {
+    public:
+        static const char* const DEFAULT_DEVICE;
+
+        /**
+         * Constructor
+         * @param devicePath The event device to read, e.g. /dev/input/event0
+         */
+        EvdevKeyboard(const std::string& devicePath = DEFAULT_DEVICE);
+        virtual ~EvdevKeyboard();
+
+        virtual bool IsKeyDown(uint8_t key);
+
+        /**
+         * Returns the lowest numbered key pressed since the last call
+         * without blocking
+         * @return The key, or NO_KEY if no key was pressed
+         */
+        virtual uint8_t GetKeyPress();
+
+        /**
+         * Forgets the presses collected so far
+         */
+        virtual void BeginKeyWait();
+
+        /**
+         * Sleeps until a key is pressed
+         * @return False if the wait was cancelled
+         */
+        virtual bool WaitForKeyPress();
+        virtual void CancelWait(bool cancelled);
+
+        /**
+         * Returns true if the device was opened
+         * @return True if key events are being read
+         */
+        bool IsOpen() const;
+
+    protected:
+        void ReaderThread();
+        void SetKey(uint16_t code, bool isDown);
+        void OnKeyPress(uint16_t code);
+
+        std::string             _devicePath;
+        int                     _fd;
+        int                     _wakePipe[2];   // Written to stop the reader thread
+        std::atomic<uint16_t>   _keyStates;
+        std::atomic<uint16_t>   _keyPresses;    // Pressed since the wait began
+        std::mutex              _waitLock;
+        std::condition_variable _waitCondition;
+        bool                    _waitCancelled;
+        std::thread*            _readerThread;
+    };
+
+} /* namespace chip8 */
+
+#endif /* EVDEVKEYBOARD_H_ */
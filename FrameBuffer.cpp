@@ -0,0 +1,46 @@
+#include "FrameBuffer.h"
+#include <string.h>
+
+namespace chip8
+{
+
+FrameBuffer::FrameBuffer()
+{
+    Clear();
+}
+
+void FrameBuffer::Clear()
+{
+    memset(_rows, 0, sizeof(_rows));
+}
+
+bool FrameBuffer::DrawSprite(uint8_t x, uint8_t y, const uint8_t* sprite, uint8_t rows)
+{
+    x %= WIDTH;
+    uint64_t collisions = 0;
+    for (uint8_t i = 0; i < rows; i++)
+    {
+        uint64_t bits = (uint64_t)sprite[i] << 56;
+        bits = (x == 0) ? bits : ((bits >> x) | (bits << (WIDTH - x)));
+        uint64_t& row = _rows[(uint8_t)(y + i) % HEIGHT];
+        collisions |= row & bits;
+        row ^= bits;
+    }
+    return (collisions != 0);
+}
+
+bool FrameBuffer::IsPixelSet(uint8_t x, uint8_t y) const
+{
+    return ((_rows[y % HEIGHT] >> (WIDTH - 1 - (x % WIDTH))) & 1) != 0;
+}
+
+const uint64_t* FrameBuffer::GetRows() const
+{
+    return _rows;
+}
+
+void FrameBuffer::SetRows(const uint64_t* rows)
+{
+    memcpy(_rows, rows, sizeof(_rows));
+}
+} /* namespace chip8 */
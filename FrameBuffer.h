@@ -0,0 +1,63 @@
+#ifndef FRAMEBUFFER_H_
+#define FRAMEBUFFER_H_
+
+#include <stdint.h>
+
+namespace chip8
+{
+    /**
+     * The 64x32 screen packed as one 64 bit word per row.  Column 0 is the
+     * most significant bit, so a sprite byte shifted to the top of a word
+     * and rotated right by x lands on columns x..x+7, wrapping at the edge.
+     */
+    class FrameBuffer
+    {
+    public:
+        static const uint8_t  WIDTH     = 64;
+        static const uint8_t  HEIGHT    = 32;
+
+        FrameBuffer();
+
+        /**
+         * Clears every pixel
+         */
+        void Clear();
+
+        /**
+         * XORs a sprite onto the screen.  Each row costs one rotate, one
+         * AND for collision and one XOR.
+         * @param x The column of the sprite's left edge
+         * @param y The row of the sprite's top edge
+         * @param sprite The sprite rows, one byte per row, MSB leftmost
+         * @param rows The number of rows in the sprite
+         * @return True if any set pixel was unset
+         */
+        bool DrawSprite(uint8_t x, uint8_t y, const uint8_t* sprite, uint8_t rows);
+
+        /**
+         * Returns true if the pixel at (x,y) is set
+         * @param x The x coordinate of the pixel
+         * @param y The y coordinate of the pixel
+         * @return True if the pixel is set
+         */
+        bool IsPixelSet(uint8_t x, uint8_t y) const;
+
+        /**
+         * Returns the packed rows
+         * @return HEIGHT rows
+         */
+        const uint64_t* GetRows() const;
+
+        /**
+         * Replaces every row
+         * @param rows HEIGHT packed rows
+         */
+        void SetRows(const uint64_t* rows);
+
+    protected:
+        uint64_t _rows[HEIGHT];
+    };
+
+} /* namespace chip8 */
+
+#endif /* FRAMEBUFFER_H_ */
@@ -0,0 +1,174 @@
+#include "FrameCapture.h"
+#include <errno.h>
+#include <string.h>
+
+#define LOG_TAG "FrameCapture"
+#include "log.h"
+
+namespace chip8
+{
+
+FrameCapture::FrameCapture()
+: _file(NULL)
+, _offset(0)
+, _keyframeInterval(DEFAULT_KEYFRAME_INTERVAL)
+, _frameCount(0)
+, _pendingRepeats(0)
+{
+    memset(_previous, 0, sizeof(_previous));
+}
+
+FrameCapture::~FrameCapture()
+{
+    Close();
+}
+
+bool FrameCapture::Open(const std::string& path, uint32_t keyframeInterval)
+{
+    Close();
+    _file = fopen(path.c_str(), "wb");
+    if (_file == NULL)
+    {
+        LOG_ERROR("Could not create %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    _keyframeInterval = keyframeInterval ? keyframeInterval : 1;
+    _frameCount = 0;
+    _pendingRepeats = 0;
+    _index.clear();
+
+    Header header = { MAGIC, VERSION, _keyframeInterval, FrameBuffer::WIDTH, FrameBuffer::HEIGHT, 0 };
+    fwrite(&header, sizeof(header), 1, _file);
+    _offset = sizeof(header);
+    return true;
+}
+
+bool FrameCapture::Close()
+{
+    if (_file == NULL)
+    {
+        return true;
+    }
+    FlushRepeats();
+
+    Trailer trailer = { _frameCount, _index.size(), _offset, INDEX_MAGIC, 0 };
+    fputc(RECORD_INDEX, _file);
+    if (!_index.empty())
+    {
+        fwrite(&_index[0], sizeof(IndexEntry), _index.size(), _file);
+    }
+    fwrite(&trailer, sizeof(trailer), 1, _file);
+
+    bool succeeded = (ferror(_file) == 0);
+    succeeded = (fclose(_file) == 0) && succeeded;
+    _file = NULL;
+    if (!succeeded)
+    {
+        LOG_ERROR("Could not write the capture");
+    }
+    return succeeded;
+}
+
+void FrameCapture::OnFrame(const FrameBuffer& frame)
+{
+    if (_file == NULL)
+    {
+        return;
+    }
+
+    const uint64_t* rows = frame.GetRows();
+    bool isKeyframe = ((_frameCount % _keyframeInterval) == 0);
+    if (!isKeyframe && (memcmp(rows, _previous, FRAME_BYTES) == 0))
+    {
+        _pendingRepeats++;
+        _frameCount++;
+        return;
+    }
+
+    FlushRepeats();
+    if (isKeyframe)
+    {
+        IndexEntry entry = { _frameCount, _offset };
+        _index.push_back(entry);
+        WriteRecord(RECORD_KEYFRAME, (const uint8_t*)rows);
+    }
+    else
+    {
+        uint64_t delta[FrameBuffer::HEIGHT];
+        for (uint8_t y = 0; y < FrameBuffer::HEIGHT; y++)
+        {
+            delta[y] = rows[y] ^ _previous[y];
+        }
+        WriteRecord(RECORD_DELTA, (const uint8_t*)delta);
+    }
+    memcpy(_previous, rows, FRAME_BYTES);
+    _frameCount++;
+}
+
+uint64_t FrameCapture::GetFrameCount() const
+{
+    return _frameCount;
+}
+
+void FrameCapture::Compress(const uint8_t* data, std::vector<uint8_t>& out)
+{
+    uint32_t i = 0;
+    while (i < FRAME_BYTES)
+    {
+        uint32_t run = 0;
+        while ((i + run < FRAME_BYTES) && (data[i + run] == 0) && (run < 128))
+        {
+            run++;
+        }
+        if (run > 0)
+        {
+            out.push_back(run - 1);
+            i += run;
+            continue;
+        }
+
+        // Literals until the next pair of zeros, a lone zero is cheaper inline
+        uint32_t start = i;
+        while ((i < FRAME_BYTES) && (i - start < 128))
+        {
+            if ((data[i] == 0) && ((i + 1 == FRAME_BYTES) || (data[i + 1] == 0)))
+            {
+                break;
+            }
+            i++;
+        }
+        out.push_back(0x80 | (i - start - 1));
+        out.insert(out.end(), data + start, data + i);
+    }
+}
+
+void FrameCapture::WriteRecord(uint8_t type, const uint8_t* data)
+{
+    _scratch.clear();
+    _scratch.push_back(type);
+    Compress(data, _scratch);
+    fwrite(&_scratch[0], 1, _scratch.size(), _file);
+    _offset += _scratch.size();
+}
+
+void FrameCapture::FlushRepeats()
+{
+    if (_pendingRepeats == 0)
+    {
+        return;
+    }
+    _scratch.clear();
+    _scratch.push_back(RECORD_REPEAT);
+    uint64_t count = _pendingRepeats;
+    while (count >= 0x80)
+    {
+        _scratch.push_back((count & 0x7F) | 0x80);
+        count >>= 7;
+    }
+    _scratch.push_back(count);
+    fwrite(&_scratch[0], 1, _scratch.size(), _file);
+    _offset += _scratch.size();
+    _pendingRepeats = 0;
+}
+} /* namespace chip8 */
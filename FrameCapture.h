@@ -0,0 +1,111 @@
+#ifndef FRAMECAPTURE_H_
+#define FRAMECAPTURE_H_
+
+#include "FrameSink.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace chip8
+{
+    /**
+     * Writes every frame to an append-only capture file.
+     *
+     * After a header, each record starts with a type byte:
+     *   RECORD_KEYFRAME  the frame, RLE coded
+     *   RECORD_DELTA     the frame XOR the previous one, RLE coded
+     *   RECORD_REPEAT    varint n: n frames identical to the previous one
+     *   RECORD_INDEX     the footer: (frame, offset) of every keyframe,
+     *                    then frame count, entry count, index offset, magic
+     * The RLE codes 256 bytes as tokens: 0nnnnnnn is n + 1 zero bytes and
+     * 1nnnnnnn is n + 1 literal bytes that follow.  Records decode without
+     * the index, so a file cut short by a crash can still be read.
+     */
+    class FrameCapture : public FrameSink
+    {
+    public:
+        static const uint32_t   MAGIC                       = 0x43463843;   // "C8FC"
+        static const uint32_t   INDEX_MAGIC                 = 0x49463843;   // "C8FI"
+        static const uint32_t   VERSION                     = 1;
+        static const uint32_t   DEFAULT_KEYFRAME_INTERVAL   = 600;          // 10 s
+        static const uint32_t   FRAME_BYTES                 = FrameBuffer::HEIGHT * sizeof(uint64_t);
+
+        enum RecordType
+        {
+            RECORD_KEYFRAME = 'K',
+            RECORD_DELTA    = 'D',
+            RECORD_REPEAT   = 'R',
+            RECORD_INDEX    = 'I',
+        };
+
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t keyframeInterval;
+            uint8_t  width;
+            uint8_t  height;
+            uint16_t reserved;
+        };
+
+        struct IndexEntry
+        {
+            uint64_t frame;
+            uint64_t offset;
+        };
+
+        struct Trailer
+        {
+            uint64_t frameCount;
+            uint64_t entryCount;
+            uint64_t indexOffset;   // Of the RECORD_INDEX byte
+            uint32_t magic;
+            uint32_t reserved;
+        };
+
+        FrameCapture();
+        virtual ~FrameCapture();
+
+        /**
+         * Creates a capture file
+         * @param path The file to write
+         * @param keyframeInterval Frames between keyframes
+         * @return True if the file was created
+         */
+        bool Open(const std::string& path, uint32_t keyframeInterval = DEFAULT_KEYFRAME_INTERVAL);
+
+        /**
+         * Writes any pending repeat and the keyframe index, then closes
+         * @return True if everything was written
+         */
+        bool Close();
+
+        virtual void OnFrame(const FrameBuffer& frame);
+
+        uint64_t GetFrameCount() const;
+
+        /**
+         * Codes FRAME_BYTES bytes with the capture's RLE
+         * @param data The bytes
+         * @param out Appended to
+         */
+        static void Compress(const uint8_t* data, std::vector<uint8_t>& out);
+
+    protected:
+        void WriteRecord(uint8_t type, const uint8_t* data);
+        void FlushRepeats();
+
+        FILE*                   _file;
+        uint64_t                _offset;            // Bytes written so far
+        uint32_t                _keyframeInterval;
+        uint64_t                _frameCount;
+        uint64_t                _pendingRepeats;
+        uint64_t                _previous[FrameBuffer::HEIGHT];
+        std::vector<IndexEntry> _index;
+        std::vector<uint8_t>    _scratch;
+    };
+
+} /* namespace chip8 */
+
+#endif /* FRAMECAPTURE_H_ */
@@ -0,0 +1,283 @@
+#include "FrameCaptureReader.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LOG_TAG "FrameCaptureReader"
+#include "log.h"
+
+namespace chip8
+{
+
+FrameCaptureReader::FrameCaptureReader()
+: _data(NULL)
+, _size(0)
+, _end(0)
+, _frameCount(0)
+, _offset(0)
+, _frame(0)
+, _repeats(0)
+, _positioned(false)
+{
+    memset(_rows, 0, sizeof(_rows));
+}
+
+FrameCaptureReader::~FrameCaptureReader()
+{
+    Close();
+}
+
+bool FrameCaptureReader::Open(const std::string& path)
+{
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        LOG_ERROR("Could not open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    struct stat info;
+    if ((fstat(fd, &info) != 0) || ((size_t)info.st_size < sizeof(FrameCapture::Header)))
+    {
+        LOG_ERROR("%s is not a frame capture", path.c_str());
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        LOG_ERROR("Could not map %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    _data = (const uint8_t*)data;
+    _size = info.st_size;
+
+    FrameCapture::Header header;
+    memcpy(&header, _data, sizeof(header));
+    if ((header.magic != FrameCapture::MAGIC) || (header.version != FrameCapture::VERSION) ||
+        (header.width != FrameBuffer::WIDTH) || (header.height != FrameBuffer::HEIGHT))
+    {
+        LOG_ERROR("%s is not a frame capture", path.c_str());
+        Close();
+        return false;
+    }
+
+    if (!BuildIndex())
+    {
+        LOG_ERROR("%s is corrupt", path.c_str());
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void FrameCaptureReader::Close()
+{
+    if (_data != NULL)
+    {
+        munmap((void*)_data, _size);
+    }
+    _data = NULL;
+    _size = 0;
+    _end = 0;
+    _index.clear();
+    _frameCount = 0;
+    _positioned = false;
+}
+
+uint64_t FrameCaptureReader::GetFrameCount() const
+{
+    return _frameCount;
+}
+
+bool FrameCaptureReader::ReadFrame(uint64_t frameNumber, FrameBuffer& frame)
+{
+    if (frameNumber >= _frameCount)
+    {
+        return false;
+    }
+
+    // Restart from the last keyframe unless it is cheaper to keep going
+    std::vector<FrameCapture::IndexEntry>::const_iterator key = std::upper_bound(_index.begin(), _index.end(), frameNumber,
+            [](uint64_t number, const FrameCapture::IndexEntry& entry) { return number < entry.frame; });
+    if (key == _index.begin())
+    {
+        return false;
+    }
+    --key;
+    if (!_positioned || (frameNumber < _frame) || (key->frame > _frame))
+    {
+        _offset = key->offset;
+        _positioned = ReadRecord();
+        if (!_positioned)
+        {
+            return false;
+        }
+        _frame = key->frame;
+    }
+
+    while (_frame < frameNumber)
+    {
+        if (_repeats > 0)
+        {
+            uint64_t skip = std::min(_repeats, frameNumber - _frame);
+            _repeats -= skip;
+            _frame += skip;
+        }
+        else if (ReadRecord())
+        {
+            _frame++;
+        }
+        else
+        {
+            _positioned = false;
+            return false;
+        }
+    }
+
+    frame.SetRows(_rows);
+    return true;
+}
+
+bool FrameCaptureReader::BuildIndex()
+{
+    FrameCapture::Trailer trailer;
+    if (_size >= sizeof(FrameCapture::Header) + 1 + sizeof(trailer))
+    {
+        memcpy(&trailer, _data + _size - sizeof(trailer), sizeof(trailer));
+        size_t indexSize = 1 + trailer.entryCount * sizeof(FrameCapture::IndexEntry) + sizeof(trailer);
+        if ((trailer.magic == FrameCapture::INDEX_MAGIC) && (trailer.indexOffset + indexSize == _size) &&
+            (_data[trailer.indexOffset] == FrameCapture::RECORD_INDEX))
+        {
+            _end = trailer.indexOffset;
+            _frameCount = trailer.frameCount;
+            _index.resize(trailer.entryCount);
+            if (!_index.empty())
+            {
+                memcpy(&_index[0], _data + _end + 1, trailer.entryCount * sizeof(FrameCapture::IndexEntry));
+            }
+            return true;
+        }
+    }
+
+    // No index, the writer never finished.  Walk the records and keep
+    // every whole frame.
+    LOG("Rebuilding the frame index");
+    _end = _size;
+    _offset = sizeof(FrameCapture::Header);
+    _frameCount = 0;
+    while ((_offset < _size) && (_data[_offset] != FrameCapture::RECORD_INDEX))
+    {
+        size_t start = _offset;
+        bool isKeyframe = (_data[_offset] == FrameCapture::RECORD_KEYFRAME);
+        if (!ReadRecord())
+        {
+            _offset = start;
+            break;
+        }
+        if (isKeyframe)
+        {
+            FrameCapture::IndexEntry entry = { _frameCount, start };
+            _index.push_back(entry);
+        }
+        _frameCount += 1 + _repeats;
+        _repeats = 0;
+    }
+    _end = _offset;
+    _positioned = false;
+    return !_index.empty() || (_frameCount == 0);
+}
+
+bool FrameCaptureReader::ReadRecord()
+{
+    if (_offset >= _end)
+    {
+        return false;
+    }
+    uint8_t type = _data[_offset++];
+    switch (type)
+    {
+        case FrameCapture::RECORD_KEYFRAME:
+        {
+            _repeats = 0;
+            return Decompress(_rows, false);
+        }
+        case FrameCapture::RECORD_DELTA:
+        {
+            _repeats = 0;
+            return Decompress(_rows, true);
+        }
+        case FrameCapture::RECORD_REPEAT:
+        {
+            // A repeat stands for frames after the one already decoded
+            uint64_t count = 0;
+            for (uint8_t shift = 0; shift < 64; shift += 7)
+            {
+                if (_offset >= _end)
+                {
+                    return false;
+                }
+                uint8_t byte = _data[_offset++];
+                count |= (uint64_t)(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                {
+                    // Counted as the first repeated frame, the rest are pending
+                    _repeats = count - 1;
+                    return (count > 0);
+                }
+            }
+            return false;
+        }
+        default:
+        {
+            return false;
+        }
+    }
+}
+
+bool FrameCaptureReader::Decompress(uint64_t* rows, bool isDelta)
+{
+    uint64_t words[FrameBuffer::HEIGHT];
+    uint8_t* bytes = (uint8_t*)words;
+    uint32_t i = 0;
+    while (i < FrameCapture::FRAME_BYTES)
+    {
+        if (_offset >= _end)
+        {
+            return false;
+        }
+        uint8_t token = _data[_offset++];
+        uint32_t length = (token & 0x7F) + 1;
+        if (i + length > FrameCapture::FRAME_BYTES)
+        {
+            return false;
+        }
+        if ((token & 0x80) == 0)
+        {
+            memset(bytes + i, 0, length);
+        }
+        else
+        {
+            if (_offset + length > _end)
+            {
+                return false;
+            }
+            memcpy(bytes + i, _data + _offset, length);
+            _offset += length;
+        }
+        i += length;
+    }
+
+    for (uint8_t y = 0; y < FrameBuffer::HEIGHT; y++)
+    {
+        rows[y] = isDelta ? (rows[y] ^ words[y]) : words[y];
+    }
+    return true;
+}
+} /* namespace chip8 */
@@ -0,0 +1,68 @@
+#ifndef FRAMECAPTUREREADER_H_
+#define FRAMECAPTUREREADER_H_
+
+#include "FrameCapture.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace chip8
+{
+    /**
+     * Reads a file written by FrameCapture.  The file is mapped read-only
+     * and any frame is reached by decoding forward from the nearest
+     * keyframe at or before it, so a seek costs at most one keyframe
+     * interval of records.  Reading frames in order decodes each record once.
+     */
+    class FrameCaptureReader
+    {
+    public:
+        FrameCaptureReader();
+        virtual ~FrameCaptureReader();
+
+        /**
+         * Maps a capture file.  Files without an index, e.g. from a run that
+         * crashed, are scanned to rebuild it.
+         * @param path The file
+         * @return True if the file is a capture
+         */
+        bool Open(const std::string& path);
+        void Close();
+
+        /**
+         * Returns the number of frames in the capture
+         * @return The frame count
+         */
+        uint64_t GetFrameCount() const;
+
+        /**
+         * Decodes a frame
+         * @param frameNumber The frame, counted from 0
+         * @param frame Receives the screen
+         * @return False if the frame is past the end or the file is corrupt
+         */
+        bool ReadFrame(uint64_t frameNumber, FrameBuffer& frame);
+
+    protected:
+        bool BuildIndex();
+        bool ReadRecord();
+        bool Decompress(uint64_t* rows, bool isDelta);
+
+        const uint8_t*                          _data;
+        size_t                                  _size;
+        size_t                                  _end;           // Start of the index, or the end of the file
+        std::vector<FrameCapture::IndexEntry>   _index;
+        uint64_t                                _frameCount;
+
+        // Decoding position: _rows holds frame _frame, whose record ends at
+        // _offset and is followed by _repeats more copies
+        size_t                                  _offset;
+        uint64_t                                _frame;
+        uint64_t                                _repeats;
+        uint64_t                                _rows[FrameBuffer::HEIGHT];
+        bool                                    _positioned;
+    };
+
+} /* namespace chip8 */
+
+#endif /* FRAMECAPTUREREADER_H_ */
@@ -0,0 +1,25 @@
+#ifndef FRAMESINK_H_
+#define FRAMESINK_H_
+
+#include "FrameBuffer.h"
+
+namespace chip8
+{
+    /**
+     * Receives the screen at the end of every 60 Hz frame
+     */
+    class FrameSink
+    {
+    public:
+        virtual ~FrameSink() {}
+
+        /**
+         * Called once per frame, after it has been presented
+         * @param frame The screen contents
+         */
+        virtual void OnFrame(const FrameBuffer& frame) = 0;
+    };
+
+} /* namespace chip8 */
+
+#endif /* FRAMESINK_H_ */
@@ -0,0 +1,46 @@
+#ifndef HOOKS_H_
+#define HOOKS_H_
+
+#include "Chip8Processor.h"
+#include "Debugger.h"
+
+namespace chip8
+{
+    /**
+     * Hook policies for the templated parts of the interpreter.  The
+     * processor picks one per frame: NoHooks when no debugger is attached,
+     * whose empty inline hooks leave exactly the plain interpreter behind,
+     * and DebugHooks otherwise.
+     */
+    struct NoHooks
+    {
+        static const bool ENABLED = false;
+
+        static bool BeforeInstruction(Chip8Processor& cpu, uint16_t pc, uint16_t instruction)
+        {
+            return true;
+        }
+
+        static void OnMemoryWrite(Chip8Processor& cpu, uint16_t address, uint16_t length)
+        {
+        }
+    };
+
+    struct DebugHooks
+    {
+        static const bool ENABLED = true;
+
+        static bool BeforeInstruction(Chip8Processor& cpu, uint16_t pc, uint16_t instruction)
+        {
+            return cpu.GetDebugger()->BeforeInstruction(cpu, pc, instruction);
+        }
+
+        static void OnMemoryWrite(Chip8Processor& cpu, uint16_t address, uint16_t length)
+        {
+            cpu.GetDebugger()->OnMemoryWrite(cpu, address, length);
+        }
+    };
+
+} /* namespace chip8 */
+
+#endif /* HOOKS_H_ */
@@ -0,0 +1,114 @@
+#include "InputRecorder.h"
+#include <errno.h>
+#include <string.h>
+
+#define LOG_TAG "InputRecorder"
+#include "log.h"
+
+namespace chip8
+{
+
+const uint32_t InputRecorder::MAGIC;
+const uint8_t InputRecorder::VERSION;
+
+InputRecorder::InputRecorder()
+: _flushed(0)
+, _lastCycles(0)
+, _eventCount(0)
+, _file(NULL)
+{
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        _data.push_back((MAGIC >> (i * 8)) & 0xFF);
+    }
+    _data.push_back(VERSION);
+}
+
+InputRecorder::~InputRecorder()
+{
+    if (_file != NULL)
+    {
+        Flush();
+        fclose(_file);
+    }
+}
+
+bool InputRecorder::Open(const std::string& path)
+{
+    if (_file != NULL)
+    {
+        Flush();
+        fclose(_file);
+    }
+    _file = fopen(path.c_str(), "wb");
+    if (_file == NULL)
+    {
+        LOG_ERROR("Could not create %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    _flushed = 0;
+    return Flush();
+}
+
+bool InputRecorder::Flush()
+{
+    if ((_file == NULL) || (_flushed == _data.size()))
+    {
+        return true;
+    }
+    size_t length = _data.size() - _flushed;
+    if (fwrite(&_data[_flushed], 1, length, _file) != length)
+    {
+        LOG_ERROR("Could not write the recording");
+        return false;
+    }
+    _flushed = _data.size();
+    return (fflush(_file) == 0);
+}
+
+void InputRecorder::RecordKeyDown(uint64_t cycles, bool isDown)
+{
+    Record(isDown ? EVENT_KEY_DOWN : EVENT_KEY_UP, cycles);
+}
+
+void InputRecorder::RecordWaitKey(uint64_t cycles, uint8_t key)
+{
+    Record(EVENT_WAIT_KEY, cycles);
+    _data.push_back(key);
+}
+
+void InputRecorder::RecordRandom(uint64_t cycles, uint8_t value)
+{
+    Record(EVENT_RANDOM, cycles);
+    _data.push_back(value);
+}
+
+const std::vector<uint8_t>& InputRecorder::GetData() const
+{
+    return _data;
+}
+
+uint32_t InputRecorder::GetEventCount() const
+{
+    return _eventCount;
+}
+
+void InputRecorder::Record(EventType type, uint64_t cycles)
+{
+    uint64_t word = ((cycles - _lastCycles) << 2) | type;
+    _lastCycles = cycles;
+    _eventCount++;
+
+    while (word >= 0x80)
+    {
+        _data.push_back((word & 0x7F) | 0x80);
+        word >>= 7;
+    }
+    _data.push_back(word);
+
+    if (_data.size() - _flushed >= FLUSH_BYTES)
+    {
+        Flush();
+    }
+}
+} /* namespace chip8 */
@@ -0,0 +1,77 @@
+#ifndef INPUTRECORDER_H_
+#define INPUTRECORDER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace chip8
+{
+    /**
+     * Records every nondeterministic input the processor sees (key queries,
+     * key waits and random draws) against the instruction count, so that
+     * InputReplayer can feed a session back bit exactly.
+     *
+     * The stream is a 4 byte magic and a version byte, then one record per
+     * event: a varint of (instructions since the last event << 2 | type),
+     * followed by a value byte for EVENT_RANDOM and EVENT_WAIT_KEY.  Key
+     * queries carry their result in the type, so most cost a single byte.
+     */
+    class InputRecorder
+    {
+    public:
+        static const uint32_t   MAGIC   = 0x52493843;   // "C8IR"
+        static const uint8_t    VERSION = 1;
+        static const size_t     FLUSH_BYTES = 4096;     // Pending bytes that trigger a write
+
+        enum EventType
+        {
+            EVENT_KEY_UP    = 0,
+            EVENT_KEY_DOWN  = 1,
+            EVENT_RANDOM    = 2,
+            EVENT_WAIT_KEY  = 3,
+        };
+
+        InputRecorder();
+        virtual ~InputRecorder();
+
+        /**
+         * Streams the recording to a file as well as keeping it in memory
+         * @param path The file to write
+         * @return True if the file was created
+         */
+        bool Open(const std::string& path);
+
+        /**
+         * Writes anything recorded since the last flush to the file.  This
+         * happens on its own every FLUSH_BYTES, on the recording thread.
+         * @return True on success, or if no file is open
+         */
+        bool Flush();
+
+        void RecordKeyDown(uint64_t cycles, bool isDown);
+        void RecordWaitKey(uint64_t cycles, uint8_t key);
+        void RecordRandom(uint64_t cycles, uint8_t value);
+
+        /**
+         * Returns the whole recording, header included
+         * @return The encoded stream
+         */
+        const std::vector<uint8_t>& GetData() const;
+
+        uint32_t GetEventCount() const;
+
+    protected:
+        void Record(EventType type, uint64_t cycles);
+
+        std::vector<uint8_t>    _data;
+        size_t                  _flushed;       // Bytes of _data already in the file
+        uint64_t                _lastCycles;
+        uint32_t                _eventCount;
+        FILE*                   _file;
+    };
+
+} /* namespace chip8 */
+
+#endif /* INPUTRECORDER_H_ */
@@ -0,0 +1,148 @@
+#include "InputReplayer.h"
+#include <fstream>
+#include <iterator>
+
+#define LOG_TAG "InputReplayer"
+#include "log.h"
+
+namespace chip8
+{
+
+InputReplayer::InputReplayer()
+: _position(0)
+, _nextCycles(0)
+, _nextType(InputRecorder::EVENT_KEY_UP)
+, _hasNext(false)
+, _desynced(false)
+{
+}
+
+InputReplayer::~InputReplayer()
+{
+}
+
+bool InputReplayer::Open(const std::string& path)
+{
+    std::ifstream file(path.c_str(), std::ifstream::binary);
+    if (!file)
+    {
+        LOG_ERROR("Could not open %s", path.c_str());
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return Load(data);
+}
+
+bool InputReplayer::Load(const std::vector<uint8_t>& data)
+{
+    _data = data;
+    _position = 0;
+    _nextCycles = 0;
+    _hasNext = false;
+    _desynced = false;
+
+    uint32_t magic = 0;
+    for (uint8_t i = 0; (i < 4) && (i < _data.size()); i++)
+    {
+        magic |= (uint32_t)_data[i] << (i * 8);
+    }
+    if ((_data.size() < 5) || (magic != InputRecorder::MAGIC) || (_data[4] != InputRecorder::VERSION))
+    {
+        LOG_ERROR("Not a recording, or the wrong version");
+        _desynced = true;
+        return false;
+    }
+    _position = 5;
+    _hasNext = Decode();
+    return true;
+}
+
+bool InputReplayer::NextKeyDown(uint64_t cycles, bool& isDown)
+{
+    // Either result is a match for a key query
+    InputRecorder::EventType type = (_nextType == InputRecorder::EVENT_KEY_DOWN) ? InputRecorder::EVENT_KEY_DOWN : InputRecorder::EVENT_KEY_UP;
+    if (!Match(type, cycles))
+    {
+        return false;
+    }
+    isDown = (type == InputRecorder::EVENT_KEY_DOWN);
+    return true;
+}
+
+bool InputReplayer::NextWaitKey(uint64_t cycles, uint8_t& key)
+{
+    if (!Match(InputRecorder::EVENT_WAIT_KEY, cycles))
+    {
+        return false;
+    }
+    key = _data[_position++];
+    _hasNext = Decode();
+    return true;
+}
+
+bool InputReplayer::NextRandom(uint64_t cycles, uint8_t& value)
+{
+    if (!Match(InputRecorder::EVENT_RANDOM, cycles))
+    {
+        return false;
+    }
+    value = _data[_position++];
+    _hasNext = Decode();
+    return true;
+}
+
+bool InputReplayer::IsFinished() const
+{
+    return !_hasNext;
+}
+
+bool InputReplayer::IsDesynced() const
+{
+    return _desynced;
+}
+
+bool InputReplayer::Decode()
+{
+    uint64_t word = 0;
+    // A corrupt recording may never end the varint; stop before the shift
+    // runs past the word
+    for (uint8_t shift = 0; shift < 64; shift += 7)
+    {
+        if (_position >= _data.size())
+        {
+            return false;
+        }
+        uint8_t byte = _data[_position++];
+        word |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            _nextType = (InputRecorder::EventType)(word & 0x3);
+            _nextCycles += (word >> 2);
+            bool hasValue = (_nextType == InputRecorder::EVENT_RANDOM) || (_nextType == InputRecorder::EVENT_WAIT_KEY);
+            return !hasValue || (_position < _data.size());
+        }
+    }
+    return false;
+}
+
+bool InputReplayer::Match(InputRecorder::EventType type, uint64_t cycles)
+{
+    if (_desynced || !_hasNext)
+    {
+        return false;
+    }
+    if ((_nextType != type) || (_nextCycles != cycles))
+    {
+        LOG_ERROR("Replay desynchronized at instruction %llu", (unsigned long long)cycles);
+        _desynced = true;
+        return false;
+    }
+
+    // Events with a value byte are advanced by the caller once it is read
+    if ((type == InputRecorder::EVENT_KEY_UP) || (type == InputRecorder::EVENT_KEY_DOWN))
+    {
+        _hasNext = Decode();
+    }
+    return true;
+}
+} /* namespace chip8 */
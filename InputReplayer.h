@@ -0,0 +1,68 @@
+#ifndef INPUTREPLAYER_H_
+#define INPUTREPLAYER_H_
+
+#include "InputRecorder.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace chip8
+{
+    /**
+     * Plays back a stream written by InputRecorder.  Each query must arrive
+     * at the same instruction count and be of the same kind as the next
+     * recorded event.  Once that fails the replay is desynchronized and
+     * every later query returns false, so the processor goes back to live
+     * input.
+     */
+    class InputReplayer
+    {
+    public:
+        InputReplayer();
+        virtual ~InputReplayer();
+
+        /**
+         * Loads a recording from a file
+         * @param path The file to read
+         * @return True if it is a valid recording
+         */
+        bool Open(const std::string& path);
+
+        /**
+         * Loads a recording from memory
+         * @param data The encoded stream, header included
+         * @return True if it is a valid recording
+         */
+        bool Load(const std::vector<uint8_t>& data);
+
+        bool NextKeyDown(uint64_t cycles, bool& isDown);
+        bool NextWaitKey(uint64_t cycles, uint8_t& key);
+        bool NextRandom(uint64_t cycles, uint8_t& value);
+
+        /**
+         * Returns true once every recorded event has been replayed
+         * @return True if the recording is used up
+         */
+        bool IsFinished() const;
+
+        /**
+         * Returns true if a query did not match the recording
+         * @return True if the replay is desynchronized
+         */
+        bool IsDesynced() const;
+
+    protected:
+        bool Decode();
+        bool Match(InputRecorder::EventType type, uint64_t cycles);
+
+        std::vector<uint8_t>        _data;
+        size_t                      _position;
+        uint64_t                    _nextCycles;    // Instruction count of the decoded event
+        InputRecorder::EventType    _nextType;
+        bool                        _hasNext;
+        bool                        _desynced;
+    };
+
+} /* namespace chip8 */
+
+#endif /* INPUTREPLAYER_H_ */
@@ -0,0 +1,220 @@
+#include "InstanceRunner.h"
+#include "Chip8Processor.h"
+
+#define LOG_TAG "InstanceRunner"
+#include "log.h"
+
+namespace chip8
+{
+
+InstanceRunner::InstanceRunner(uint32_t workerCount, uint32_t sliceFrames)
+: _sliceFrames(sliceFrames ? sliceFrames : 1)
+, _nextWorker(0)
+, _queued(0)
+, _pending(0)
+, _alive(true)
+, _framesExecuted(0)
+, _steals(0)
+{
+    if (workerCount == 0)
+    {
+        workerCount = std::thread::hardware_concurrency();
+        if (workerCount == 0)
+        {
+            workerCount = 1;
+        }
+    }
+
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        _workers.push_back(new Worker());
+    }
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        _workers[i]->thread = new std::thread(&InstanceRunner::WorkerThread, this, i);
+    }
+    LOG("Started %u workers", workerCount);
+}
+
+InstanceRunner::~InstanceRunner()
+{
+    {
+        std::lock_guard<std::mutex> lock(_idleLock);
+        _alive = false;
+    }
+    _workAvailable.notify_all();
+
+    for (size_t i = 0; i < _workers.size(); i++)
+    {
+        _workers[i]->thread->join();
+        delete _workers[i]->thread;
+        delete _workers[i];
+    }
+}
+
+uint32_t InstanceRunner::Add(Chip8Processor* processor, uint32_t frames)
+{
+    Task* task;
+    uint32_t id;
+    {
+        std::lock_guard<std::mutex> lock(_tasksLock);
+        id = _tasks.size();
+        Task newTask = { processor, frames, true };
+        _tasks.push_back(newTask);
+        task = &_tasks.back();
+    }
+
+    Worker* worker = _workers[_nextWorker++ % _workers.size()];
+    _pending++;
+    {
+        std::lock_guard<std::mutex> lock(worker->lock);
+        worker->queue.push_back(task);
+    }
+    {
+        std::lock_guard<std::mutex> lock(_idleLock);
+        _queued++;
+    }
+    _workAvailable.notify_one();
+    return id;
+}
+
+void InstanceRunner::Wait()
+{
+    {
+        std::unique_lock<std::mutex> lock(_idleLock);
+        while (_pending != 0)
+        {
+            _allDone.wait(lock);
+        }
+    }
+
+    // Every task is done, so no worker holds one.  Keep only the results,
+    // so a runner used for batch after batch does not grow.
+    std::lock_guard<std::mutex> lock(_tasksLock);
+    _results.assign(_tasks.size(), false);
+    for (size_t i = 0; i < _tasks.size(); i++)
+    {
+        _results[i] = _tasks[i].succeeded;
+    }
+    _tasks.clear();
+}
+
+bool InstanceRunner::GetResult(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(_tasksLock);
+    return (id < _results.size()) && _results[id];
+}
+
+uint32_t InstanceRunner::GetWorkerCount() const
+{
+    return _workers.size();
+}
+
+uint64_t InstanceRunner::GetFramesExecuted() const
+{
+    return _framesExecuted;
+}
+
+uint64_t InstanceRunner::GetSteals() const
+{
+    return _steals;
+}
+
+InstanceRunner::Task* InstanceRunner::TakeTask(uint32_t index)
+{
+    Task* task = NULL;
+
+    // Our own queue in order, so unfinished tasks requeued at the back
+    // take turns with the rest instead of running straight to the end
+    Worker* self = _workers[index];
+    {
+        std::lock_guard<std::mutex> lock(self->lock);
+        if (!self->queue.empty())
+        {
+            task = self->queue.front();
+            self->queue.pop_front();
+        }
+    }
+
+    // Otherwise steal the newest work from someone else, the task its
+    // owner would get to last
+    for (size_t i = 1; (task == NULL) && (i < _workers.size()); i++)
+    {
+        Worker* victim = _workers[(index + i) % _workers.size()];
+        std::lock_guard<std::mutex> lock(victim->lock);
+        if (!victim->queue.empty())
+        {
+            task = victim->queue.back();
+            victim->queue.pop_back();
+            _steals.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (task != NULL)
+    {
+        _queued--;
+    }
+    return task;
+}
+
+void InstanceRunner::RunSlice(uint32_t index, Task* task)
+{
+    uint32_t frames = (task->framesLeft < _sliceFrames) ? task->framesLeft : _sliceFrames;
+    uint32_t ran = 0;
+    for (; ran < frames; ran++)
+    {
+        if (!task->processor->RunFrame())
+        {
+            task->succeeded = false;
+            task->framesLeft = 0;
+            break;
+        }
+    }
+    _framesExecuted.fetch_add(ran, std::memory_order_relaxed);
+
+    if (task->succeeded)
+    {
+        task->framesLeft -= frames;
+    }
+
+    if (task->framesLeft == 0)
+    {
+        std::lock_guard<std::mutex> lock(_idleLock);
+        if (--_pending == 0)
+        {
+            _allDone.notify_all();
+        }
+        return;
+    }
+
+    Worker* self = _workers[index];
+    {
+        std::lock_guard<std::mutex> lock(self->lock);
+        self->queue.push_back(task);
+    }
+    {
+        std::lock_guard<std::mutex> lock(_idleLock);
+        _queued++;
+    }
+    _workAvailable.notify_one();
+}
+
+void InstanceRunner::WorkerThread(uint32_t index)
+{
+    while (_alive)
+    {
+        Task* task = TakeTask(index);
+        if (task != NULL)
+        {
+            RunSlice(index, task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_idleLock);
+        while (_alive && (_queued == 0))
+        {
+            _workAvailable.wait(lock);
+        }
+    }
+}
+} /* namespace chip8 */
@@ -0,0 +1,103 @@
+#ifndef INSTANCERUNNER_H_
+#define INSTANCERUNNER_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace chip8
+{
+    class Chip8Processor;
+
+    /**
+     * Runs many processors on a fixed pool of worker threads, one per core.
+     *
+     * Each processor is a task that runs a slice of frames with RunFrame()
+     * and is then put back at the back of its worker's queue.  Workers
+     * take from the front of their own queue, so their tasks take turns,
+     * and idle workers steal from the back of someone else's.  Processors
+     * added here must not be started with Run(); the pool is the only
+     * thing driving them.
+     */
+    class InstanceRunner
+    {
+    public:
+        static const uint32_t DEFAULT_SLICE_FRAMES = 8;
+
+        /**
+         * Constructor
+         * @param workerCount The number of worker threads, or 0 for one per core
+         * @param sliceFrames The number of frames a task runs before it is requeued
+         */
+        InstanceRunner(uint32_t workerCount = 0, uint32_t sliceFrames = DEFAULT_SLICE_FRAMES);
+        virtual ~InstanceRunner();
+
+        /**
+         * Queues a processor to run for a number of frames
+         * @param processor The processor, not owned by the runner
+         * @param frames The number of frames to run
+         * @return An id for GetResult.  Ids start from 0 again after Wait.
+         */
+        uint32_t Add(Chip8Processor* processor, uint32_t frames);
+
+        /**
+         * Blocks until every queued processor has finished
+         */
+        void Wait();
+
+        /**
+         * Returns true if the processor ran all of its frames without an
+         * instruction failing.  Only valid after Wait, for the processors
+         * added before it.
+         * @param id The id returned by Add
+         * @return True on success
+         */
+        bool GetResult(uint32_t id);
+
+        uint32_t GetWorkerCount() const;
+        uint64_t GetFramesExecuted() const;
+        uint64_t GetSteals() const;
+
+    protected:
+        struct Task
+        {
+            Chip8Processor* processor;
+            uint32_t        framesLeft;
+            bool            succeeded;
+        };
+
+        struct Worker
+        {
+            std::mutex          lock;
+            std::deque<Task*>   queue;
+            std::thread*        thread;
+        };
+
+        void WorkerThread(uint32_t index);
+        Task* TakeTask(uint32_t index);
+        void RunSlice(uint32_t index, Task* task);
+
+        uint32_t                _sliceFrames;
+        std::vector<Worker*>    _workers;
+        std::mutex              _tasksLock;
+        std::deque<Task>        _tasks;         // Since the last Wait
+        std::vector<bool>       _results;       // Of the tasks before the last Wait
+        uint32_t                _nextWorker;
+
+        std::mutex              _idleLock;
+        std::condition_variable _workAvailable;
+        std::condition_variable _allDone;
+        std::atomic<uint32_t>   _queued;        // Tasks sitting in a queue
+        std::atomic<uint32_t>   _pending;       // Tasks not finished yet
+        std::atomic<bool>       _alive;
+        std::atomic<uint64_t>   _framesExecuted;
+        std::atomic<uint64_t>   _steals;
+    };
+
+} /* namespace chip8 */
+
+#endif /* INSTANCERUNNER_H_ */
@@ -4,25 +4,49 @@
 #include <stdint.h>
 namespace chip8
 {
+    /**
+     * Interface for the 16 key hexadecimal keypad
+     */
     class Keyboard
     {
     public:
-        Keyboard();
-        virtual ~Keyboard();
+        static const uint8_t  NUM_KEYS  = 16;
+        static const uint8_t  NO_KEY    = 0x10;
+
+        virtual ~Keyboard() {}
 
         /**
          * Returns true if the key is currently down
          * @param key The number of the key to check
          * @return True if the key is pressed
          */
-        bool IsKeyDown(uint8_t key);
+        virtual bool IsKeyDown(uint8_t key) = 0;
+
+        /**
+         * Returns a key pressed since the last call without blocking
+         * @return The number of the key that was pressed, or NO_KEY
+         */
+        virtual uint8_t GetKeyPress() = 0;
+
+        /**
+         * Called when Fx0A starts waiting, before its first GetKeyPress.
+         * Presses made before this must not end the wait.
+         */
+        virtual void BeginKeyWait() = 0;
+
+        /**
+         * Blocks until GetKeyPress has a key to return, or until the wait
+         * is cancelled.  The key press is left for GetKeyPress.
+         * @return False if the wait was cancelled
+         */
+        virtual bool WaitForKeyPress() = 0;
 
         /**
-         * Waits for a key to be pressed and returns the
-         * number of the key that is pressed
-         * @return The number of the key that was pressed
+         * Wakes WaitForKeyPress and makes it return false at once until
+         * the cancel is lifted
+         * @param cancelled True to cancel waits, false to allow them again
          */
-        uint8_t WaitForKey();
+        virtual void CancelWait(bool cancelled) = 0;
     };
 
 } /* namespace chip8 */
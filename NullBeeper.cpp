@@ -0,0 +1,31 @@
+#include "NullBeeper.h"
+
+namespace chip8
+{
+
+NullBeeper::NullBeeper()
+: _isBeeping(false)
+{
+}
+
+NullBeeper::~NullBeeper()
+{
+}
+
+bool NullBeeper::StartBeeping()
+{
+    _isBeeping = true;
+    return true;
+}
+
+bool NullBeeper::StopBeeping()
+{
+    _isBeeping = false;
+    return true;
+}
+
+bool NullBeeper::IsBeeping() const
+{
+    return _isBeeping;
+}
+} /* namespace chip8 */
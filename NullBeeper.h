@@ -0,0 +1,32 @@
+#ifndef NULLBEEPER_H_
+#define NULLBEEPER_H_
+
+#include "Beeper.h"
+
+namespace chip8
+{
+    /**
+     * Silent beeper backend.  Only remembers whether it should be beeping.
+     */
+    class NullBeeper : public Beeper
+    {
+    public:
+        NullBeeper();
+        virtual ~NullBeeper();
+
+        virtual bool StartBeeping();
+        virtual bool StopBeeping();
+
+        /**
+         * Returns true if the sound timer is currently running
+         * @return True if a tone would be playing
+         */
+        bool IsBeeping() const;
+
+    protected:
+        bool    _isBeeping;
+    };
+
+} /* namespace chip8 */
+
+#endif /* NULLBEEPER_H_ */
@@ -0,0 +1,38 @@
+#include "NullDisplay.h"
+
+namespace chip8
+{
+
+NullDisplay::NullDisplay()
+{
+}
+
+NullDisplay::~NullDisplay()
+{
+}
+
+void NullDisplay::Clear()
+{
+    _frame.Clear();
+}
+
+bool NullDisplay::DrawSprite(uint8_t x, uint8_t y, const uint8_t* sprite, uint8_t rows)
+{
+    return _frame.DrawSprite(x, y, sprite, rows);
+}
+
+bool NullDisplay::IsPixelSet(uint8_t x, uint8_t y) const
+{
+    return _frame.IsPixelSet(x, y);
+}
+
+const FrameBuffer& NullDisplay::GetFrame() const
+{
+    return _frame;
+}
+
+void NullDisplay::SetFrame(const FrameBuffer& frame)
+{
+    _frame = frame;
+}
+} /* namespace chip8 */
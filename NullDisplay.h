@@ -0,0 +1,40 @@
+#ifndef NULLDISPLAY_H_
+#define NULLDISPLAY_H_
+
+#include "Display.h"
+#include "FrameBuffer.h"
+#include <stdint.h>
+
+namespace chip8
+{
+    /**
+     * Headless display backend.  Keeps the pixels in memory only, so
+     * it needs no terminal and starts no threads.
+     */
+    class NullDisplay : public Display
+    {
+    public:
+        NullDisplay();
+        virtual ~NullDisplay();
+
+        virtual void Clear();
+        virtual bool DrawSprite(uint8_t x, uint8_t y, const uint8_t* sprite, uint8_t rows);
+
+        /**
+         * Returns true if the pixel at (x,y) is set
+         * @param x The x coordinate of the pixel
+         * @param y The y coordinate of the pixel
+         * @return True if the pixel is set
+         */
+        bool IsPixelSet(uint8_t x, uint8_t y) const;
+
+        virtual const FrameBuffer& GetFrame() const;
+        virtual void SetFrame(const FrameBuffer& frame);
+
+    protected:
+        FrameBuffer _frame;
+    };
+
+} /* namespace chip8 */
+
+#endif /* NULLDISPLAY_H_ */
@@ -0,0 +1,113 @@
+#include "PcmBeeper.h"
+#include <string.h>
+
+#define LOG_TAG "PcmBeeper"
+#include "log.h"
+
+namespace chip8
+{
+
+PcmBeeper::PcmBeeper(PcmSink* sink, uint32_t sampleRate, uint32_t frequency)
+: _sink(sink)
+, _sampleRate(sampleRate)
+, _frequency(frequency)
+, _isBeeping(false)
+, _level(AMPLITUDE)
+, _phase(0)
+, _frames(0)
+, _frameStartCycles(0)
+, _written(0)
+{
+}
+
+PcmBeeper::~PcmBeeper()
+{
+}
+
+bool PcmBeeper::StartBeeping()
+{
+    if (!_isBeeping)
+    {
+        // Every tone starts at the top of a period, wherever it falls
+        _isBeeping = true;
+        _level = AMPLITUDE;
+        _phase = 0;
+    }
+    return true;
+}
+
+bool PcmBeeper::StopBeeping()
+{
+    _isBeeping = false;
+    return true;
+}
+
+void PcmBeeper::Advance(uint64_t cycles, uint32_t instructionsPerFrame)
+{
+    if (instructionsPerFrame == 0)
+    {
+        return;
+    }
+
+    // Loading a state can move the cycle count anywhere; keep to this frame
+    uint64_t offset = (cycles > _frameStartCycles) ? (cycles - _frameStartCycles) : 0;
+    if (offset > instructionsPerFrame)
+    {
+        offset = instructionsPerFrame;
+    }
+
+    uint64_t start = FrameStart(_frames);
+    uint64_t length = FrameStart(_frames + 1) - start;
+    Render(start + (offset * length) / instructionsPerFrame);
+}
+
+void PcmBeeper::EndFrame(uint64_t cycles)
+{
+    _frames++;
+    Render(FrameStart(_frames));
+    _frameStartCycles = cycles;
+}
+
+uint64_t PcmBeeper::GetSampleCount() const
+{
+    return _written;
+}
+
+uint64_t PcmBeeper::FrameStart(uint64_t frame) const
+{
+    // Exact even when the rate is not a multiple of 60
+    return (frame * _sampleRate) / FRAME_RATE;
+}
+
+void PcmBeeper::Render(uint64_t end)
+{
+    while (_written < end)
+    {
+        uint32_t count = ((end - _written) < BUFFER_SAMPLES) ? (uint32_t)(end - _written) : BUFFER_SAMPLES;
+        if (_isBeeping)
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                _buffer[i] = _level;
+                _phase += 2 * _frequency;
+                if (_phase >= _sampleRate)
+                {
+                    _phase -= _sampleRate;
+                    _level = -_level;
+                }
+            }
+        }
+        else
+        {
+            memset(_buffer, 0, count * sizeof(int16_t));
+        }
+
+        if (_sink != NULL)
+        {
+            _sink->Write(_buffer, count);
+        }
+        _written += count;
+    }
+}
+
+} /* namespace chip8 */
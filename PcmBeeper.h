@@ -0,0 +1,65 @@
+#ifndef PCMBEEPER_H_
+#define PCMBEEPER_H_
+
+#include "Beeper.h"
+#include "PcmSink.h"
+
+namespace chip8
+{
+    /**
+     * Beeper backend that synthesizes a square wave from emulated time.
+     *
+     * Each frame is 1/60 s of samples, and StartBeeping and StopBeeping
+     * land on the sample matching the instruction that changed the sound
+     * timer.  The output depends only on the program, not on how fast it
+     * ran, and nothing runs while the processor is idle.
+     */
+    class PcmBeeper : public Beeper
+    {
+    public:
+        static const uint32_t   DEFAULT_SAMPLE_RATE = 44100;
+        static const uint32_t   DEFAULT_FREQUENCY   = 440;
+        static const int16_t    AMPLITUDE           = 8192;
+        static const uint32_t   FRAME_RATE          = 60;
+
+        /**
+         * @param sink Where the samples go, not owned
+         * @param sampleRate Samples per second
+         * @param frequency Tone in Hz
+         */
+        PcmBeeper(PcmSink* sink, uint32_t sampleRate = DEFAULT_SAMPLE_RATE,
+                uint32_t frequency = DEFAULT_FREQUENCY);
+        virtual ~PcmBeeper();
+
+        virtual bool StartBeeping();
+        virtual bool StopBeeping();
+        virtual void Advance(uint64_t cycles, uint32_t instructionsPerFrame);
+        virtual void EndFrame(uint64_t cycles);
+
+        /**
+         * Returns the number of samples written so far
+         * @return The sample count
+         */
+        uint64_t GetSampleCount() const;
+
+    protected:
+        static const uint32_t   BUFFER_SAMPLES = 1024;
+
+        uint64_t FrameStart(uint64_t frame) const;
+        void Render(uint64_t end);
+
+        PcmSink*    _sink;
+        uint32_t    _sampleRate;
+        uint32_t    _frequency;
+        bool        _isBeeping;
+        int16_t     _level;             // Current half of the square wave
+        uint32_t    _phase;             // Counts 2 * frequency per sample up to the rate
+        uint64_t    _frames;            // Frames ended so far
+        uint64_t    _frameStartCycles;  // Cycle count when this frame began
+        uint64_t    _written;           // Samples written so far
+        int16_t     _buffer[BUFFER_SAMPLES];
+    };
+
+} /* namespace chip8 */
+
+#endif /* PCMBEEPER_H_ */
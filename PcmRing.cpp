@@ -0,0 +1,37 @@
+#include "PcmRing.h"
+#include <string.h>
+
+namespace chip8
+{
+
+PcmRing::PcmRing()
+: _dropped(0)
+{
+}
+
+PcmRing::~PcmRing()
+{
+}
+
+void PcmRing::Write(const int16_t* samples, uint32_t count)
+{
+    uint32_t written = _samples.Push(samples, count);
+    if (written < count)
+    {
+        _dropped.fetch_add(count - written, std::memory_order_relaxed);
+    }
+}
+
+uint32_t PcmRing::Read(int16_t* samples, uint32_t count)
+{
+    uint32_t read = _samples.Pop(samples, count);
+    memset(samples + read, 0, (count - read) * sizeof(int16_t));
+    return read;
+}
+
+uint64_t PcmRing::GetDroppedCount() const
+{
+    return _dropped.load(std::memory_order_relaxed);
+}
+
+} /* namespace chip8 */
@@ -0,0 +1,46 @@
+#ifndef PCMRING_H_
+#define PCMRING_H_
+
+#include "PcmSink.h"
+#include "SpscQueue.h"
+
+namespace chip8
+{
+    /**
+     * Hands samples from the execution thread to a host audio callback
+     * through a lock-free ring.  Neither side ever blocks: samples that do
+     * not fit are dropped, and a read that runs dry is padded with silence.
+     */
+    class PcmRing : public PcmSink
+    {
+    public:
+        static const uint32_t   CAPACITY = 16384;     // ~370 ms at 44.1 kHz
+
+        PcmRing();
+        virtual ~PcmRing();
+
+        virtual void Write(const int16_t* samples, uint32_t count);
+
+        /**
+         * Fills a buffer for the audio device.  Call from one thread only.
+         * @param samples Receives exactly count samples
+         * @param count The number of samples wanted
+         * @return The number that came from the ring, the rest are silence
+         */
+        uint32_t Read(int16_t* samples, uint32_t count);
+
+        /**
+         * Returns the number of samples dropped because the ring was full,
+         * as happens when the processor runs faster than real time
+         * @return The dropped sample count
+         */
+        uint64_t GetDroppedCount() const;
+
+    protected:
+        SpscQueue<int16_t, CAPACITY>    _samples;
+        std::atomic<uint64_t>           _dropped;
+    };
+
+} /* namespace chip8 */
+
+#endif /* PCMRING_H_ */
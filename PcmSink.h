@@ -0,0 +1,26 @@
+#ifndef PCMSINK_H_
+#define PCMSINK_H_
+
+#include <stdint.h>
+
+namespace chip8
+{
+    /**
+     * Receives the mono 16-bit samples made by PcmBeeper
+     */
+    class PcmSink
+    {
+    public:
+        virtual ~PcmSink() {}
+
+        /**
+         * Called as emulated time passes, silence included
+         * @param samples The samples
+         * @param count The number of samples
+         */
+        virtual void Write(const int16_t* samples, uint32_t count) = 0;
+    };
+
+} /* namespace chip8 */
+
+#endif /* PCMSINK_H_ */
@@ -0,0 +1,351 @@
+#include "Profiler.h"
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#define LOG_TAG "Profiler"
+#include "log.h"
+
+namespace chip8
+{
+
+namespace
+{
+    const char* const classNames[] =
+    {
+        "CLS", "RET", "SYS", "JP", "CALL", "SE Vx,byte", "SNE Vx,byte", "SE Vx,Vy",
+        "LD Vx,byte", "ADD Vx,byte", "LD Vx,Vy", "OR", "AND", "XOR", "ADD Vx,Vy", "SUB",
+        "SHR", "SUBN", "SHL", "SNE Vx,Vy", "LD I", "JP V0", "RND", "DRW",
+        "SKP", "SKNP", "LD Vx,DT", "LD Vx,K", "LD DT", "LD ST", "ADD I", "LD F",
+        "LD B", "LD [I],Vx", "LD Vx,[I]", "INVALID",
+    };
+}
+
+Profiler::Profiler()
+{
+    Reset();
+
+    // Time an empty interval the same way the processor times a handler
+    _clockOverhead = ~0ULL;
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        _clockOverhead = (ns < _clockOverhead) ? ns : _clockOverhead;
+    }
+    LOG_DEBUG("Clock overhead is %llu ns", (unsigned long long)_clockOverhead);
+}
+
+Profiler::~Profiler()
+{
+}
+
+void Profiler::Reset()
+{
+    memset(_counts, 0, sizeof(_counts));
+    memset(_nanoseconds, 0, sizeof(_nanoseconds));
+    memset(_pcCounts, 0, sizeof(_pcCounts));
+    _instructions = 0;
+    _calls.clear();
+    _loops.clear();
+    _callStack.clear();
+}
+
+Profiler::OpcodeClass Profiler::Classify(uint16_t instruction)
+{
+    switch (instruction >> 12)
+    {
+        case 0:
+        {
+            if (instruction == 0x00E0)
+            {
+                return OP_CLS;
+            }
+            if (instruction == 0x00EE)
+            {
+                return OP_RET;
+            }
+            return OP_SYS;
+        }
+        case 1:     return OP_JP;
+        case 2:     return OP_CALL;
+        case 3:     return OP_SE_BYTE;
+        case 4:     return OP_SNE_BYTE;
+        case 5:     return ((instruction & 0xF) == 0) ? OP_SE_REG : OP_INVALID;
+        case 6:     return OP_LD_BYTE;
+        case 7:     return OP_ADD_BYTE;
+        case 8:
+        {
+            switch (instruction & 0xF)
+            {
+                case 0x0:   return OP_LD_REG;
+                case 0x1:   return OP_OR;
+                case 0x2:   return OP_AND;
+                case 0x3:   return OP_XOR;
+                case 0x4:   return OP_ADD_REG;
+                case 0x5:   return OP_SUB;
+                case 0x6:   return OP_SHR;
+                case 0x7:   return OP_SUBN;
+                case 0xE:   return OP_SHL;
+                default:    return OP_INVALID;
+            }
+        }
+        case 9:     return ((instruction & 0xF) == 0) ? OP_SNE_REG : OP_INVALID;
+        case 10:    return OP_LD_I;
+        case 11:    return OP_JP_V0;
+        case 12:    return OP_RND;
+        case 13:    return OP_DRW;
+        case 14:
+        {
+            switch (instruction & 0xFF)
+            {
+                case 0x9E:  return OP_SKP;
+                case 0xA1:  return OP_SKNP;
+                default:    return OP_INVALID;
+            }
+        }
+        default:
+        {
+            switch (instruction & 0xFF)
+            {
+                case 0x07:  return OP_LD_V_DT;
+                case 0x0A:  return OP_LD_K;
+                case 0x15:  return OP_LD_DT;
+                case 0x18:  return OP_LD_ST;
+                case 0x1E:  return OP_ADD_I;
+                case 0x29:  return OP_LD_F;
+                case 0x33:  return OP_LD_B;
+                case 0x55:  return OP_LD_I_V;
+                case 0x65:  return OP_LD_V_I;
+                default:    return OP_INVALID;
+            }
+        }
+    }
+}
+
+const char* Profiler::GetClassName(OpcodeClass opcodeClass)
+{
+    return (opcodeClass < OPCODE_CLASS_COUNT) ? classNames[opcodeClass] : "?";
+}
+
+void Profiler::Record(uint16_t pc, uint16_t instruction, uint16_t nextPc, uint64_t nanoseconds)
+{
+    OpcodeClass opcodeClass = Classify(instruction);
+    _counts[opcodeClass]++;
+    _nanoseconds[opcodeClass] += (nanoseconds > _clockOverhead) ? (nanoseconds - _clockOverhead) : 0;
+    _pcCounts[pc & (PC_COUNT - 1)]++;
+    _instructions++;
+
+    if (opcodeClass == OP_CALL)
+    {
+        Frame frame = { pc, nextPc, _instructions };
+        _callStack.push_back(frame);
+        Edge& edge = _calls[((uint32_t)pc << 16) | nextPc];
+        edge.from = pc;
+        edge.to = nextPc;
+        edge.count++;
+    }
+    else if (opcodeClass == OP_RET)
+    {
+        if (!_callStack.empty())
+        {
+            const Frame& frame = _callStack.back();
+            _calls[((uint32_t)frame.site << 16) | frame.target].instructions += _instructions - frame.startInstruction;
+            _callStack.pop_back();
+        }
+    }
+    else if (nextPc <= pc)
+    {
+        // Any other backward transfer closes a loop
+        Edge& edge = _loops[((uint32_t)pc << 16) | nextPc];
+        edge.from = pc;
+        edge.to = nextPc;
+        edge.count++;
+    }
+}
+
+uint64_t Profiler::GetCount(OpcodeClass opcodeClass) const
+{
+    return _counts[opcodeClass];
+}
+
+uint64_t Profiler::GetNanoseconds(OpcodeClass opcodeClass) const
+{
+    return _nanoseconds[opcodeClass];
+}
+
+uint64_t Profiler::GetPcCount(uint16_t pc) const
+{
+    return _pcCounts[pc & (PC_COUNT - 1)];
+}
+
+uint64_t Profiler::GetInstructionCount() const
+{
+    return _instructions;
+}
+
+uint64_t Profiler::LoopInstructions(const Edge& loop) const
+{
+    // Everything executed between the target and the branch counts as the
+    // body, which overestimates loops with code jumped over from outside
+    uint64_t instructions = 0;
+    for (uint32_t pc = loop.to; pc <= loop.from; pc++)
+    {
+        instructions += _pcCounts[pc];
+    }
+    return instructions;
+}
+
+void Profiler::SortedEdges(const std::unordered_map<uint32_t, Edge>& edges, std::vector<Edge>& sorted) const
+{
+    sorted.clear();
+    for (std::unordered_map<uint32_t, Edge>::const_iterator it = edges.begin(); it != edges.end(); ++it)
+    {
+        sorted.push_back(it->second);
+    }
+    if (&edges == &_loops)
+    {
+        for (size_t i = 0; i < sorted.size(); i++)
+        {
+            sorted[i].instructions = LoopInstructions(sorted[i]);
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Edge& a, const Edge& b)
+    {
+        return (a.instructions != b.instructions) ? (a.instructions > b.instructions) : (a.count > b.count);
+    });
+}
+
+void Profiler::SortedClasses(std::vector<uint8_t>& sorted) const
+{
+    sorted.clear();
+    for (uint8_t i = 0; i < OPCODE_CLASS_COUNT; i++)
+    {
+        if (_counts[i] != 0)
+        {
+            sorted.push_back(i);
+        }
+    }
+    const uint64_t* nanoseconds = _nanoseconds;
+    std::sort(sorted.begin(), sorted.end(), [nanoseconds](uint8_t a, uint8_t b)
+    {
+        return nanoseconds[a] > nanoseconds[b];
+    });
+}
+
+void Profiler::WriteText(FILE* file) const
+{
+    std::vector<uint8_t> classes;
+    SortedClasses(classes);
+    uint64_t totalNs = 0;
+    for (uint8_t i = 0; i < OPCODE_CLASS_COUNT; i++)
+    {
+        totalNs += _nanoseconds[i];
+    }
+
+    fprintf(file, "%llu instructions, %.3f ms in handlers\n\n",
+            (unsigned long long)_instructions, totalNs / 1e6);
+
+    fprintf(file, "Handlers by time\n");
+    fprintf(file, "  %-12s %14s %12s %8s %6s\n", "class", "count", "ns", "ns/op", "time%");
+    for (size_t i = 0; i < classes.size(); i++)
+    {
+        uint8_t c = classes[i];
+        fprintf(file, "  %-12s %14llu %12llu %8.1f %5.1f%%\n", classNames[c],
+                (unsigned long long)_counts[c], (unsigned long long)_nanoseconds[c],
+                (double)_nanoseconds[c] / _counts[c], totalNs ? 100.0 * _nanoseconds[c] / totalNs : 0.0);
+    }
+
+    std::vector<Edge> edges;
+    SortedEdges(_loops, edges);
+    fprintf(file, "\nHottest loops\n");
+    fprintf(file, "  %-13s %14s %14s\n", "range", "iterations", "instructions");
+    for (size_t i = 0; (i < edges.size()) && (i < REPORT_ROWS); i++)
+    {
+        fprintf(file, "  0x%03x-0x%03x %14llu %14llu\n", edges[i].to, edges[i].from,
+                (unsigned long long)edges[i].count, (unsigned long long)edges[i].instructions);
+    }
+
+    SortedEdges(_calls, edges);
+    fprintf(file, "\nCalls\n");
+    fprintf(file, "  %-13s %14s %14s\n", "site->target", "calls", "instructions");
+    for (size_t i = 0; (i < edges.size()) && (i < REPORT_ROWS); i++)
+    {
+        fprintf(file, "  0x%03x->0x%03x %14llu %14llu\n", edges[i].from, edges[i].to,
+                (unsigned long long)edges[i].count, (unsigned long long)edges[i].instructions);
+    }
+}
+
+void Profiler::WriteJson(FILE* file) const
+{
+    fprintf(file, "{\"instructions\": %llu, \"classes\": [", (unsigned long long)_instructions);
+    std::vector<uint8_t> classes;
+    SortedClasses(classes);
+    for (size_t i = 0; i < classes.size(); i++)
+    {
+        uint8_t c = classes[i];
+        fprintf(file, "%s\n  {\"class\": \"%s\", \"count\": %llu, \"ns\": %llu}", i ? "," : "",
+                classNames[c], (unsigned long long)_counts[c], (unsigned long long)_nanoseconds[c]);
+    }
+
+    fprintf(file, "\n], \"loops\": [");
+    std::vector<Edge> edges;
+    SortedEdges(_loops, edges);
+    for (size_t i = 0; i < edges.size(); i++)
+    {
+        fprintf(file, "%s\n  {\"branch\": %u, \"target\": %u, \"iterations\": %llu, \"instructions\": %llu}",
+                i ? "," : "", edges[i].from, edges[i].to,
+                (unsigned long long)edges[i].count, (unsigned long long)edges[i].instructions);
+    }
+
+    fprintf(file, "\n], \"calls\": [");
+    SortedEdges(_calls, edges);
+    for (size_t i = 0; i < edges.size(); i++)
+    {
+        fprintf(file, "%s\n  {\"site\": %u, \"target\": %u, \"calls\": %llu, \"instructions\": %llu}",
+                i ? "," : "", edges[i].from, edges[i].to,
+                (unsigned long long)edges[i].count, (unsigned long long)edges[i].instructions);
+    }
+
+    fprintf(file, "\n], \"pc\": [");
+    bool first = true;
+    for (uint16_t pc = 0; pc < PC_COUNT; pc++)
+    {
+        if (_pcCounts[pc] != 0)
+        {
+            fprintf(file, "%s[%u, %llu]", first ? "" : ", ", pc, (unsigned long long)_pcCounts[pc]);
+            first = false;
+        }
+    }
+    fprintf(file, "]}\n");
+}
+
+bool Profiler::WriteReport(const std::string& basePath) const
+{
+    std::string textPath = basePath + ".txt";
+    std::string jsonPath = basePath + ".json";
+    FILE* text = fopen(textPath.c_str(), "w");
+    FILE* json = fopen(jsonPath.c_str(), "w");
+    bool succeeded = (text != NULL) && (json != NULL);
+    if (succeeded)
+    {
+        WriteText(text);
+        WriteJson(json);
+        LOG("Wrote %s and %s", textPath.c_str(), jsonPath.c_str());
+    }
+    else
+    {
+        LOG_ERROR("Could not write the profile to %s", basePath.c_str());
+    }
+    if (text != NULL)
+    {
+        fclose(text);
+    }
+    if (json != NULL)
+    {
+        fclose(json);
+    }
+    return succeeded;
+}
+} /* namespace chip8 */
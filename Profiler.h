@@ -0,0 +1,107 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace chip8
+{
+    /**
+     * Collects where a program spends its time: executions and host
+     * nanoseconds per opcode class, a hit count per PC, call graph edges
+     * with the instructions spent inside each subroutine, and backward
+     * branches (loops).  The processor feeds it one Record() per
+     * instruction while it is attached; nothing is collected otherwise.
+     */
+    class Profiler
+    {
+    public:
+        enum OpcodeClass
+        {
+            OP_CLS, OP_RET, OP_SYS, OP_JP, OP_CALL, OP_SE_BYTE, OP_SNE_BYTE, OP_SE_REG,
+            OP_LD_BYTE, OP_ADD_BYTE, OP_LD_REG, OP_OR, OP_AND, OP_XOR, OP_ADD_REG, OP_SUB,
+            OP_SHR, OP_SUBN, OP_SHL, OP_SNE_REG, OP_LD_I, OP_JP_V0, OP_RND, OP_DRW,
+            OP_SKP, OP_SKNP, OP_LD_V_DT, OP_LD_K, OP_LD_DT, OP_LD_ST, OP_ADD_I, OP_LD_F,
+            OP_LD_B, OP_LD_I_V, OP_LD_V_I, OP_INVALID,
+            OPCODE_CLASS_COUNT
+        };
+
+        static const uint16_t   PC_COUNT    = 0x1000;
+        static const uint8_t    REPORT_ROWS = 10;
+
+        Profiler();
+        virtual ~Profiler();
+
+        /**
+         * Clears everything collected so far
+         */
+        void Reset();
+
+        /**
+         * Accounts for one executed instruction
+         * @param pc The address of the instruction
+         * @param instruction The instruction
+         * @param nextPc The program counter after it ran
+         * @param nanoseconds The host time it took, including reading the clock
+         */
+        void Record(uint16_t pc, uint16_t instruction, uint16_t nextPc, uint64_t nanoseconds);
+
+        /**
+         * Returns the class an instruction is counted under
+         * @param instruction The instruction
+         * @return The opcode class
+         */
+        static OpcodeClass Classify(uint16_t instruction);
+        static const char* GetClassName(OpcodeClass opcodeClass);
+
+        uint64_t GetCount(OpcodeClass opcodeClass) const;
+        uint64_t GetNanoseconds(OpcodeClass opcodeClass) const;
+        uint64_t GetPcCount(uint16_t pc) const;
+        uint64_t GetInstructionCount() const;
+
+        void WriteText(FILE* file) const;
+        void WriteJson(FILE* file) const;
+
+        /**
+         * Writes basePath.txt and basePath.json
+         * @param basePath The report path without extension
+         * @return True if both files were written
+         */
+        bool WriteReport(const std::string& basePath) const;
+
+    protected:
+        struct Edge
+        {
+            uint16_t    from;
+            uint16_t    to;
+            uint64_t    count;
+            uint64_t    instructions;   // Inside the callee or the loop body
+        };
+
+        struct Frame
+        {
+            uint16_t    site;
+            uint16_t    target;
+            uint64_t    startInstruction;
+        };
+
+        void SortedEdges(const std::unordered_map<uint32_t, Edge>& edges, std::vector<Edge>& sorted) const;
+        void SortedClasses(std::vector<uint8_t>& sorted) const;
+        uint64_t LoopInstructions(const Edge& loop) const;
+
+        uint64_t                            _counts[OPCODE_CLASS_COUNT];
+        uint64_t                            _nanoseconds[OPCODE_CLASS_COUNT];
+        uint64_t                            _pcCounts[PC_COUNT];
+        uint64_t                            _instructions;
+        uint64_t                            _clockOverhead; // Cost of timing nothing, taken off each sample
+        std::unordered_map<uint32_t, Edge>  _calls;     // Keyed by site << 16 | target
+        std::unordered_map<uint32_t, Edge>  _loops;     // Keyed by branch << 16 | target
+        std::vector<Frame>                  _callStack;
+    };
+
+} /* namespace chip8 */
+
+#endif /* PROFILER_H_ */
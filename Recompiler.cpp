@@ -0,0 +1,452 @@
+#include "Recompiler.h"
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define RECOMPILER_X86_64 1
+#endif
+
+#define LOG_TAG "Recompiler"
+#include "log.h"
+
+namespace chip8
+{
+
+namespace
+{
+    // Worst case bytes emitted for one block, including prologue/epilogue
+    const size_t MAX_BLOCK_BYTES = 4096;
+
+    // x86-64 register numbers used in ModRM bytes
+    const uint8_t REG_AL = 0;
+    const uint8_t REG_CL = 1;
+    const uint8_t REG_DL = 2;
+
+    bool IsBodyInstruction(uint16_t instruction)
+    {
+        switch (instruction >> 12)
+        {
+            case 6:
+            case 7:
+            case 10:
+                return true;
+
+            case 8:
+            {
+                switch (instruction & 0x000F)
+                {
+                    case 0: case 1: case 2: case 3: case 4:
+                    case 5: case 6: case 7: case 14:
+                        return true;
+                }
+            }
+            return false;
+
+            case 15:
+            {
+                uint16_t low = (instruction & 0x00FF);
+                return (low == 0x1E) || (low == 0x29);
+            }
+        }
+        return false;
+    }
+
+    bool IsTerminator(uint16_t instruction)
+    {
+        switch (instruction >> 12)
+        {
+            case 1:
+            case 3:
+            case 4:
+                return true;
+
+            case 5:
+            case 9:
+                return ((instruction & 0x000F) == 0);
+        }
+        return false;
+    }
+}
+
+Recompiler::Recompiler(const uint8_t* ram, uint16_t ramSize)
+: _ram(ram)
+, _ramSize(ramSize)
+, _code(NULL)
+, _codeUsed(0)
+{
+    _blocks = new BlockFunction[ramSize / 2];
+    _blockStates = new uint8_t[ramSize / 2];
+    _blockLengths = new uint8_t[ramSize / 2];
+    _covered = new uint8_t[ramSize];
+
+#ifdef RECOMPILER_X86_64
+    // Never writable and executable at once: the buffer starts out
+    // read-execute and Translate opens only the pages it is writing
+    void* code = mmap(NULL, CODE_BUFFER_SIZE, PROT_READ | PROT_EXEC,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code != MAP_FAILED)
+    {
+        _code = (uint8_t*)code;
+    }
+    else
+    {
+        LOG_ERROR("Could not map executable memory");
+    }
+#endif
+    Flush();
+}
+
+Recompiler::~Recompiler()
+{
+#ifdef RECOMPILER_X86_64
+    if (_code != NULL)
+    {
+        munmap(_code, CODE_BUFFER_SIZE);
+    }
+#endif
+    delete[] _blocks;
+    delete[] _blockStates;
+    delete[] _blockLengths;
+    delete[] _covered;
+}
+
+bool Recompiler::IsSupported() const
+{
+    return (_code != NULL);
+}
+
+void Recompiler::Flush()
+{
+    LOG_DEBUG("%s", __FUNCTION__);
+    _codeUsed = 0;
+    memset(_blocks, 0, sizeof(BlockFunction) * (_ramSize / 2));
+    memset(_blockStates, BLOCK_UNKNOWN, _ramSize / 2);
+    memset(_covered, 0, _ramSize);
+}
+
+void Recompiler::Invalidate(uint16_t address, uint16_t length)
+{
+    uint32_t end = (uint32_t)address + length;
+    if (end > _ramSize)
+    {
+        end = _ramSize;
+    }
+
+    for (uint32_t i = address; i < end; i++)
+    {
+        if (_covered[i] != 0)
+        {
+            Flush();
+            return;
+        }
+        // New code may be translatable where the old code was not
+        _blockStates[i >> 1] = BLOCK_UNKNOWN;
+    }
+}
+
+uint32_t Recompiler::Execute(uint8_t* v, uint16_t* I, uint16_t* pc, uint32_t budget)
+{
+    uint16_t address = *pc;
+    if ((_code == NULL) || ((address & 1) != 0) || (address >= _ramSize))
+    {
+        return 0;
+    }
+
+    uint16_t entry = (address >> 1);
+    if (_blockStates[entry] == BLOCK_UNKNOWN)
+    {
+        _blocks[entry] = Translate(address);
+        _blockStates[entry] = (_blocks[entry] != NULL) ? BLOCK_TRANSLATED : BLOCK_INTERPRET;
+    }
+
+    // A block that would run past the budget is left to the interpreter,
+    // so frames end on exactly the same instruction in every mode
+    if ((_blockStates[entry] != BLOCK_TRANSLATED) || (_blockLengths[entry] > budget))
+    {
+        return 0;
+    }
+    return _blocks[entry](v, I, pc);
+}
+
+void Recompiler::Emit(uint8_t byte)
+{
+    _code[_codeUsed++] = byte;
+}
+
+void Recompiler::Emit(uint8_t b0, uint8_t b1)
+{
+    Emit(b0);
+    Emit(b1);
+}
+
+void Recompiler::Emit(uint8_t b0, uint8_t b1, uint8_t b2)
+{
+    Emit(b0);
+    Emit(b1);
+    Emit(b2);
+}
+
+void Recompiler::Emit16(uint16_t value)
+{
+    Emit(value & 0xFF, value >> 8);
+}
+
+void Recompiler::Emit32(uint32_t value)
+{
+    Emit16(value & 0xFFFF);
+    Emit16(value >> 16);
+}
+
+Recompiler::BlockFunction Recompiler::Translate(uint16_t address)
+{
+#ifdef RECOMPILER_X86_64
+    // Find the extent of the block first
+    uint16_t bodyLength = 0;
+    bool usesI = false;
+    bool hasTerminator = false;
+    uint16_t end = address;
+    while ((bodyLength < MAX_BLOCK_LENGTH) && ((uint32_t)end + 1 < _ramSize))
+    {
+        uint16_t instruction = (_ram[end] << 8) | _ram[end + 1];
+        if (IsBodyInstruction(instruction))
+        {
+            usesI |= ((instruction >> 12) == 10) || ((instruction >> 12) == 15);
+            bodyLength++;
+            end += 2;
+        }
+        else
+        {
+            hasTerminator = IsTerminator(instruction);
+            break;
+        }
+    }
+
+    if ((bodyLength == 0) && !hasTerminator)
+    {
+        return NULL;
+    }
+
+    if ((CODE_BUFFER_SIZE - _codeUsed) < MAX_BLOCK_BYTES)
+    {
+        Flush();
+    }
+    BlockFunction block = (BlockFunction)(_code + _codeUsed);
+
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    uint8_t* pages = _code + (_codeUsed & ~(pageSize - 1));
+    size_t pagesLength = (_code + _codeUsed + MAX_BLOCK_BYTES) - pages;
+    if (mprotect(pages, pagesLength, PROT_READ | PROT_WRITE) != 0)
+    {
+        LOG_ERROR("Could not make code writable");
+        return NULL;
+    }
+
+    // Prologue: r10 = pc pointer, r8d = I
+    Emit(0x49, 0x89, 0xD2);                         // mov r10, rdx
+    if (usesI)
+    {
+        Emit(0x44, 0x0F, 0xB7); Emit(0x06);         // movzx r8d, word [rsi]
+    }
+
+    uint16_t pc = address;
+    for (uint16_t i = 0; i < bodyLength; i++, pc += 2)
+    {
+        uint16_t instruction = (_ram[pc] << 8) | _ram[pc + 1];
+        uint8_t x = (instruction & 0x0F00) >> 8;
+        uint8_t y = (instruction & 0x00F0) >> 4;
+        uint8_t kk = (instruction & 0x00FF);
+
+        // mov reg8, [rdi + n] / mov [rdi + n], reg8
+        #define LOAD(reg, n)    Emit(0x8A, 0x47 | ((reg) << 3), (n))
+        #define STORE(n, reg)   Emit(0x88, 0x47 | ((reg) << 3), (n))
+
+        switch (instruction >> 12)
+        {
+            case 6:
+            {
+                Emit(0xC6, 0x47, x); Emit(kk);      // mov byte [rdi + x], kk
+            }
+            break;
+
+            case 7:
+            {
+                Emit(0x80, 0x47, x); Emit(kk);      // add byte [rdi + x], kk
+            }
+            break;
+
+            case 10:
+            {
+                Emit(0x41, 0xB8);                   // mov r8d, nnn
+                Emit32(instruction & 0x0FFF);
+            }
+            break;
+
+            case 15:
+            {
+                Emit(0x0F, 0xB6, 0x47); Emit(x);    // movzx eax, byte [rdi + x]
+                if (kk == 0x1E)
+                {
+                    Emit(0x41, 0x01, 0xC0);         // add r8d, eax
+                }
+                else
+                {
+                    Emit(0x44, 0x8D, 0x04); Emit(0x80); // lea r8d, [rax + rax * 4]
+                }
+            }
+            break;
+
+            case 8:
+            {
+                // Follows the statement order of Chip8Processor::Math so
+                // that x or y being VF behaves identically
+                switch (instruction & 0x000F)
+                {
+                    case 0:
+                    {
+                        LOAD(REG_AL, y);
+                        STORE(x, REG_AL);
+                    }
+                    break;
+
+                    case 1:
+                    case 2:
+                    case 3:
+                    {
+                        static const uint8_t opcodes[] = { 0, 0x08, 0x20, 0x30 };  // or, and, xor
+                        LOAD(REG_AL, x);
+                        LOAD(REG_CL, y);
+                        Emit(opcodes[instruction & 0x000F], 0xC8);  // op al, cl
+                        STORE(x, REG_AL);
+                    }
+                    break;
+
+                    case 4:
+                    {
+                        LOAD(REG_AL, x);
+                        Emit(0x88, 0xC2);                   // mov dl, al
+                        LOAD(REG_CL, y);
+                        Emit(0x00, 0xC8);                   // add al, cl
+                        STORE(x, REG_AL);
+                        LOAD(REG_AL, x);
+                        Emit(0x38, 0xD0);                   // cmp al, dl
+                        Emit(0x0F, 0x92, 0xC1);             // setb cl
+                        STORE(15, REG_CL);
+                    }
+                    break;
+
+                    case 5:
+                    case 7:
+                    {
+                        // 5: VF = Vx > Vy; Vx = Vx - Vy
+                        // 7: VF = Vy > Vx; Vx = Vy - Vx
+                        uint8_t a = ((instruction & 0x000F) == 5) ? x : y;
+                        uint8_t b = ((instruction & 0x000F) == 5) ? y : x;
+                        LOAD(REG_AL, a);
+                        LOAD(REG_CL, b);
+                        Emit(0x38, 0xC8);                   // cmp al, cl
+                        Emit(0x0F, 0x97, 0xC2);             // seta dl
+                        STORE(15, REG_DL);
+                        LOAD(REG_AL, a);
+                        LOAD(REG_CL, b);
+                        Emit(0x28, 0xC8);                   // sub al, cl
+                        STORE(x, REG_AL);
+                    }
+                    break;
+
+                    case 6:
+                    {
+                        LOAD(REG_DL, x);
+                        Emit(0x80, 0xE2, 0x01);             // and dl, 1
+                        STORE(15, REG_DL);
+                        LOAD(REG_AL, x);
+                        Emit(0xD0, 0xE8);                   // shr al, 1
+                        STORE(x, REG_AL);
+                    }
+                    break;
+
+                    case 14:
+                    {
+                        LOAD(REG_DL, x);
+                        Emit(0xC0, 0xEA, 0x07);             // shr dl, 7
+                        STORE(15, REG_DL);
+                        LOAD(REG_AL, x);
+                        Emit(0xD0, 0xE0);                   // shl al, 1
+                        STORE(x, REG_AL);
+                    }
+                    break;
+                }
+            }
+            break;
+        }
+    }
+
+    uint32_t count = bodyLength;
+    if (hasTerminator)
+    {
+        uint16_t instruction = (_ram[pc] << 8) | _ram[pc + 1];
+        uint8_t x = (instruction & 0x0F00) >> 8;
+        uint8_t y = (instruction & 0x00F0) >> 4;
+        count++;
+
+        if ((instruction >> 12) == 1)
+        {
+            Emit(0x66, 0x41, 0xC7); Emit(0x02);     // mov word [r10], nnn
+            Emit16(instruction & 0x0FFF);
+        }
+        else
+        {
+            uint8_t cmov = 0x44;                    // cmove
+            switch (instruction >> 12)
+            {
+                case 3:
+                case 4:
+                {
+                    Emit(0x80, 0x7F, x);            // cmp byte [rdi + x], kk
+                    Emit(instruction & 0x00FF);
+                    cmov = ((instruction >> 12) == 3) ? 0x44 : 0x45;
+                }
+                break;
+
+                default:
+                {
+                    LOAD(REG_AL, x);
+                    Emit(0x3A, 0x47, y);            // cmp al, [rdi + y]
+                    cmov = ((instruction >> 12) == 5) ? 0x44 : 0x45;
+                }
+                break;
+            }
+            Emit(0xB9); Emit32(pc + 2);             // mov ecx, pc + 2
+            Emit(0xBA); Emit32(pc + 4);             // mov edx, pc + 4
+            Emit(0x0F, cmov, 0xCA);                 // cmovcc ecx, edx
+            Emit(0x66, 0x41, 0x89); Emit(0x0A);     // mov [r10], cx
+        }
+        pc += 2;
+    }
+    else
+    {
+        Emit(0x66, 0x41, 0xC7); Emit(0x02);         // mov word [r10], pc
+        Emit16(pc);
+    }
+
+    #undef LOAD
+    #undef STORE
+
+    // Epilogue
+    if (usesI)
+    {
+        Emit(0x66, 0x44, 0x89); Emit(0x06);         // mov [rsi], r8w
+    }
+    Emit(0xB8); Emit32(count);                      // mov eax, count
+    Emit(0xC3);                                     // ret
+    mprotect(pages, pagesLength, PROT_READ | PROT_EXEC);
+
+    memset(_covered + address, 1, pc - address);
+    _blockLengths[address >> 1] = count;
+    LOG_DEBUG("Translated 0x%x-0x%x, %u instructions", address, pc, count);
+    return block;
+#else
+    return NULL;
+#endif
+}
+} /* namespace chip8 */
@@ -0,0 +1,92 @@
+#ifndef RECOMPILER_H_
+#define RECOMPILER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace chip8
+{
+    /**
+     * Dynamic recompiler that translates straight-line runs of CHIP-8
+     * register instructions into x86-64 code.
+     *
+     * A block covers 6xkk, 7xkk, 8xyN, Annn, Fx1E and Fx29 and ends at the
+     * first instruction it cannot translate, or with a translated 1nnn jump
+     * or 3xkk/4xkk/5xy0/9xy0 skip.  Everything else (calls, draws, keys,
+     * timers, random, memory stores) is left to the interpreter.  Inside a
+     * block I and PC live in host registers and the V registers are
+     * addressed off a base register.
+     */
+    class Recompiler
+    {
+    public:
+        typedef uint32_t (*BlockFunction)(uint8_t* v, uint16_t* I, uint16_t* pc);
+
+        static const uint16_t MAX_BLOCK_LENGTH  = 64;         // Instructions
+        static const size_t   CODE_BUFFER_SIZE  = 1 << 20;    // 1 MiB
+
+        /**
+         * Constructor
+         * @param ram The processor memory the blocks are translated from
+         * @param ramSize The size of the processor memory in bytes
+         */
+        Recompiler(const uint8_t* ram, uint16_t ramSize);
+        virtual ~Recompiler();
+
+        /**
+         * Returns true if the recompiler can run on this host
+         * @return True on x86-64 hosts where executable memory can be mapped
+         */
+        bool IsSupported() const;
+
+        /**
+         * Runs the block at *pc, translating it first if needed
+         * @param v The V registers
+         * @param I The I register
+         * @param pc The program counter, updated to the next instruction
+         * @param budget The most instructions the block may execute
+         * @return The number of instructions executed, or 0 if the
+         *         instruction at *pc must be run by the interpreter
+         */
+        uint32_t Execute(uint8_t* v, uint16_t* I, uint16_t* pc, uint32_t budget);
+
+        /**
+         * Discards translated code if a RAM write hits a translated range
+         * @param address The first byte written
+         * @param length The number of bytes written
+         */
+        void Invalidate(uint16_t address, uint16_t length);
+
+        /**
+         * Discards all translated code
+         */
+        void Flush();
+
+    protected:
+        enum BlockState
+        {
+            BLOCK_UNKNOWN       = 0,
+            BLOCK_TRANSLATED    = 1,
+            BLOCK_INTERPRET     = 2
+        };
+
+        BlockFunction Translate(uint16_t address);
+        void Emit(uint8_t byte);
+        void Emit(uint8_t b0, uint8_t b1);
+        void Emit(uint8_t b0, uint8_t b1, uint8_t b2);
+        void Emit16(uint16_t value);
+        void Emit32(uint32_t value);
+
+        const uint8_t*  _ram;
+        uint16_t        _ramSize;
+        uint8_t*        _code;
+        size_t          _codeUsed;
+        BlockFunction*  _blocks;        // One per even address
+        uint8_t*        _blockStates;   // One per even address
+        uint8_t*        _blockLengths;  // Instructions per translated block
+        uint8_t*        _covered;       // One per RAM byte, non-zero if translated
+    };
+
+} /* namespace chip8 */
+
+#endif /* RECOMPILER_H_ */
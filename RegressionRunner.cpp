@@ -0,0 +1,229 @@
+#include "RegressionRunner.h"
+#include "Chip8Processor.h"
+#include "Chip8State.h"
+#include "InstanceRunner.h"
+#include "NullDisplay.h"
+#include "NullBeeper.h"
+#include "ScriptedKeyboard.h"
+#include "StaticProgram.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define LOG_TAG "RegressionRunner"
+#include "log.h"
+
+namespace chip8
+{
+
+namespace
+{
+    // One headless processor and the backends it owns
+    struct Instance
+    {
+        NullDisplay         display;
+        ScriptedKeyboard    keyboard;
+        NullBeeper          beeper;
+        Chip8Processor      processor;
+        uint32_t            id;
+
+        Instance() : processor(&keyboard, &display, &beeper), id(0) {}
+
+        static void* operator new(size_t size) { return Chip8Processor::operator new(size); }
+        static void operator delete(void* memory) { Chip8Processor::operator delete(memory); }
+    };
+
+    bool CompareNames(const RegressionRunner::Result& a, const RegressionRunner::Result& b)
+    {
+        return a.name < b.name;
+    }
+}
+
+RegressionRunner::RegressionRunner(uint32_t frames)
+: _frames(frames)
+{
+}
+
+RegressionRunner::~RegressionRunner()
+{
+}
+
+bool RegressionRunner::AddPath(const std::string& path)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+    {
+        LOG_ERROR("Could not read %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    if (!S_ISDIR(info.st_mode))
+    {
+        return AddFile(path);
+    }
+
+    DIR* directory = opendir(path.c_str());
+    if (directory == NULL)
+    {
+        LOG_ERROR("Could not open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    std::vector<std::string> files;
+    for (struct dirent* entry = readdir(directory); entry != NULL; entry = readdir(directory))
+    {
+        std::string file = path + "/" + entry->d_name;
+        if ((entry->d_name[0] != '.') && (stat(file.c_str(), &info) == 0) && S_ISREG(info.st_mode))
+        {
+            files.push_back(file);
+        }
+    }
+    closedir(directory);
+
+    bool succeeded = true;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        succeeded = AddFile(files[i]) && succeeded;
+    }
+    return succeeded;
+}
+
+bool RegressionRunner::AddFile(const std::string& path)
+{
+    Rom rom;
+    std::ifstream file(path.c_str(), std::ifstream::binary);
+    rom.image.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (rom.image.empty() || (rom.image.size() > RomPack::MAX_ROM_LENGTH))
+    {
+        LOG_ERROR("%s is not a ROM: %zu bytes", path.c_str(), rom.image.size());
+        return false;
+    }
+    rom.name = path.substr(path.find_last_of('/') + 1);
+    rom.data = NULL;
+    rom.length = rom.image.size();
+    _roms.push_back(rom);
+    return true;
+}
+
+void RegressionRunner::AddRom(const RomView& rom)
+{
+    Rom entry;
+    entry.name = rom.name;
+    entry.data = rom.data;
+    entry.length = rom.length;
+    _roms.push_back(entry);
+}
+
+void RegressionRunner::Run(uint32_t workerCount)
+{
+    InstanceRunner runner(workerCount);
+    _results.clear();
+
+    // A few hundred at a time, so thousands of ROMs don't all hold a
+    // processor at once
+    std::vector<Instance*> instances;
+    for (size_t first = 0; first < _roms.size(); first += BATCH_SIZE)
+    {
+        size_t last = std::min(first + BATCH_SIZE, _roms.size());
+        for (size_t i = first; i < last; i++)
+        {
+            const Rom& rom = _roms[i];
+            const uint8_t* data = (rom.data != NULL) ? rom.data : &rom.image[0];
+            Instance* instance = new Instance();
+            Chip8Processor& processor = instance->processor;
+            processor.SetRandomSeed(RANDOM_SEED);
+
+            // Compiled ROMs give the same results, only sooner
+            RomView view = { rom.name.c_str(), data, rom.length, RomPack::Hash(data, rom.length) };
+            processor.LoadRom(view);
+            if (StaticProgram::Find(view.hash) != NULL)
+            {
+                processor.SetExecutionMode(Chip8Processor::EXEC_STATIC);
+            }
+            processor.Reset();
+            instance->id = runner.Add(&processor, _frames);
+            instances.push_back(instance);
+        }
+        runner.Wait();
+
+        for (size_t i = 0; i < instances.size(); i++)
+        {
+            // Zeroed first so the padding hashes the same every time
+            Chip8State state;
+            memset(&state, 0, sizeof(state));
+            instances[i]->processor.SaveState(state);
+
+            Result result;
+            result.name = _roms[first + i].name;
+            result.hash = RomPack::Hash((const uint8_t*)&state, sizeof(state));
+            result.succeeded = runner.GetResult(instances[i]->id);
+            if (!result.succeeded)
+            {
+                LOG_ERROR("%s: an instruction failed", _roms[first + i].name.c_str());
+            }
+            _results.push_back(result);
+            delete instances[i];
+        }
+        instances.clear();
+    }
+    std::sort(_results.begin(), _results.end(), CompareNames);
+}
+
+const std::vector<RegressionRunner::Result>& RegressionRunner::GetResults() const
+{
+    return _results;
+}
+
+void RegressionRunner::Write(FILE* file) const
+{
+    for (size_t i = 0; i < _results.size(); i++)
+    {
+        fprintf(file, "%016" PRIx64 "  %s\n", _results[i].hash, _results[i].name.c_str());
+    }
+}
+
+int RegressionRunner::Compare(const std::string& path, FILE* report) const
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == NULL)
+    {
+        LOG_ERROR("Could not open %s: %s", path.c_str(), strerror(errno));
+        return -1;
+    }
+    std::map<std::string, uint64_t> golden;
+    char line[512];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        uint64_t hash;
+        char name[sizeof(line)];
+        if (sscanf(line, "%" SCNx64 " %511[^\n]", &hash, name) == 2)
+        {
+            golden[name] = hash;
+        }
+    }
+    fclose(file);
+
+    int mismatches = 0;
+    for (size_t i = 0; i < _results.size(); i++)
+    {
+        const Result& result = _results[i];
+        std::map<std::string, uint64_t>::const_iterator it = golden.find(result.name);
+        if (it == golden.end())
+        {
+            fprintf(report, "MISSING  %s: %016" PRIx64 " is not in %s\n", result.name.c_str(), result.hash, path.c_str());
+            mismatches++;
+        }
+        else if (it->second != result.hash)
+        {
+            fprintf(report, "FAIL     %s: expected %016" PRIx64 ", got %016" PRIx64 "\n",
+                    result.name.c_str(), it->second, result.hash);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+} /* namespace chip8 */
@@ -0,0 +1,100 @@
+#ifndef REGRESSIONRUNNER_H_
+#define REGRESSIONRUNNER_H_
+
+#include "RomPack.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace chip8
+{
+    /**
+     * Runs ROMs headless for a fixed number of frames and hashes where they
+     * end up, for golden-file regression tests.
+     *
+     * Every ROM runs on its own processor with the Null backends, no key
+     * presses and a fixed random seed, at full speed on an InstanceRunner
+     * pool.  The hash is FNV-1a over the saved Chip8State: registers,
+     * timers, cycle count, screen and RAM.  Results are written one per
+     * line as "hash  name", sorted by name, which is also the golden file
+     * format.  ROMs are named after their file name without the directory,
+     * so the golden file does not depend on where the ROMs are.
+     */
+    class RegressionRunner
+    {
+    public:
+        static const uint32_t   RANDOM_SEED = 0xC8C8C8C8;
+        static const uint32_t   BATCH_SIZE  = 256;     // Processors alive at once
+
+        struct Result
+        {
+            std::string name;
+            uint64_t    hash;
+            bool        succeeded;  // False if an instruction failed
+        };
+
+        /**
+         * Constructor
+         * @param frames The number of frames each ROM runs for
+         */
+        RegressionRunner(uint32_t frames);
+        virtual ~RegressionRunner();
+
+        /**
+         * Queues a ROM file, or every file in a directory
+         * @param path The file or directory
+         * @return False if it could not be read or is not a ROM
+         */
+        bool AddPath(const std::string& path);
+
+        /**
+         * Queues a ROM from a pack.  The pack must stay open until Run.
+         * @param rom The ROM
+         */
+        void AddRom(const RomView& rom);
+
+        /**
+         * Runs everything queued
+         * @param workerCount The number of threads, 0 for one per core
+         */
+        void Run(uint32_t workerCount = 0);
+
+        const std::vector<Result>& GetResults() const;
+
+        /**
+         * Writes the results in golden file format
+         * @param file Where to write them
+         */
+        void Write(FILE* file) const;
+
+        /**
+         * Checks the results against a golden file and reports every ROM
+         * that differs or is missing from it.  ROMs in the golden file that
+         * were not run are ignored.
+         * @param path The golden file
+         * @param report Where to write the mismatches
+         * @return The number of mismatches, or -1 if the file can't be read
+         */
+        int Compare(const std::string& path, FILE* report) const;
+
+    protected:
+        struct Rom
+        {
+            std::string             name;
+            const uint8_t*          data;       // In a pack, or NULL to use image
+            uint16_t                length;
+            std::vector<uint8_t>    image;      // Read from a file
+        };
+
+        bool AddFile(const std::string& path);
+
+        uint32_t            _frames;
+        std::vector<Rom>    _roms;
+        std::vector<Result> _results;
+    };
+
+} /* namespace chip8 */
+
+#endif /* REGRESSIONRUNNER_H_ */
@@ -0,0 +1,228 @@
+#include "RomPack.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#define LOG_TAG "RomPack"
+#include "log.h"
+
+namespace chip8
+{
+
+namespace
+{
+    bool EntryNameLess(const RomPack::Entry& a, const RomPack::Entry& b)
+    {
+        return strcmp(a.name, b.name) < 0;
+    }
+}
+
+RomPack::RomPack()
+: _mapping(NULL)
+, _size(0)
+, _header(NULL)
+, _entries(NULL)
+{
+}
+
+RomPack::~RomPack()
+{
+    Close();
+}
+
+bool RomPack::Open(const std::string& path)
+{
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        LOG_ERROR("Could not open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    struct stat info;
+    if ((fstat(fd, &info) != 0) || ((size_t)info.st_size < sizeof(Header)))
+    {
+        LOG_ERROR("%s is not a ROM pack", path.c_str());
+        close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        LOG_ERROR("Could not map %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    _mapping = (const uint8_t*)mapping;
+    _size = info.st_size;
+    _header = (const Header*)_mapping;
+    _entries = (const Entry*)(_mapping + sizeof(Header));
+
+    // Check the index once here so lookups need no checks
+    bool valid = (_header->magic == MAGIC) && (_header->version == VERSION) &&
+                 (sizeof(Header) + (uint64_t)_header->count * sizeof(Entry) <= _size);
+    for (uint32_t i = 0; valid && (i < _header->count); i++)
+    {
+        const Entry& entry = _entries[i];
+        valid = (entry.length <= MAX_ROM_LENGTH) &&
+                ((uint64_t)entry.offset + entry.length <= _size) &&
+                (memchr(entry.name, 0, NAME_LENGTH) != NULL);
+    }
+    if (!valid)
+    {
+        LOG_ERROR("%s is not a valid ROM pack", path.c_str());
+        Close();
+        return false;
+    }
+
+    LOG("Mapped %u ROMs from %s", _header->count, path.c_str());
+    return true;
+}
+
+void RomPack::Close()
+{
+    if (_mapping != NULL)
+    {
+        munmap((void*)_mapping, _size);
+    }
+    _mapping = NULL;
+    _size = 0;
+    _header = NULL;
+    _entries = NULL;
+}
+
+uint32_t RomPack::GetCount() const
+{
+    return (_header != NULL) ? _header->count : 0;
+}
+
+bool RomPack::GetRom(uint32_t index, RomView& rom) const
+{
+    if (index >= GetCount())
+    {
+        return false;
+    }
+    const Entry& entry = _entries[index];
+    rom.name = entry.name;
+    rom.data = _mapping + entry.offset;
+    rom.length = entry.length;
+    rom.hash = entry.hash;
+    return true;
+}
+
+bool RomPack::Find(const std::string& name, RomView& rom) const
+{
+    uint32_t low = 0;
+    uint32_t high = GetCount();
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+        int order = strcmp(_entries[middle].name, name.c_str());
+        if (order == 0)
+        {
+            return GetRom(middle, rom);
+        }
+        if (order < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return false;
+}
+
+bool RomPack::Create(const std::string& path, const std::vector<std::string>& romPaths)
+{
+    std::vector<Entry> entries;
+    std::vector<uint8_t> images;
+    uint32_t imageOffset = sizeof(Header) + romPaths.size() * sizeof(Entry);
+
+    for (size_t i = 0; i < romPaths.size(); i++)
+    {
+        std::ifstream file(romPaths[i].c_str(), std::ifstream::binary);
+        if (!file)
+        {
+            LOG_ERROR("Could not open %s", romPaths[i].c_str());
+            return false;
+        }
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (data.empty() || (data.size() > MAX_ROM_LENGTH))
+        {
+            LOG_ERROR("%s is not a ROM: %zu bytes", romPaths[i].c_str(), data.size());
+            return false;
+        }
+
+        std::string name = romPaths[i].substr(romPaths[i].find_last_of('/') + 1);
+        if (name.size() >= NAME_LENGTH)
+        {
+            LOG_ERROR("%s: the name is longer than %u characters", romPaths[i].c_str(), NAME_LENGTH - 1);
+            return false;
+        }
+
+        Entry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.hash = Hash(&data[0], data.size());
+        entry.offset = imageOffset + images.size();
+        entry.length = data.size();
+        memcpy(entry.name, name.c_str(), name.size());
+        entries.push_back(entry);
+        images.insert(images.end(), data.begin(), data.end());
+    }
+
+    std::sort(entries.begin(), entries.end(), EntryNameLess);
+    for (size_t i = 1; i < entries.size(); i++)
+    {
+        if (strcmp(entries[i - 1].name, entries[i].name) == 0)
+        {
+            LOG_ERROR("%s is in the pack twice", entries[i].name);
+            return false;
+        }
+    }
+
+    Header header = { MAGIC, VERSION, (uint32_t)entries.size(), 0 };
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == NULL)
+    {
+        LOG_ERROR("Could not create %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    bool succeeded = (fwrite(&header, sizeof(header), 1, file) == 1);
+    if (succeeded && !entries.empty())
+    {
+        succeeded = (fwrite(&entries[0], sizeof(Entry), entries.size(), file) == entries.size()) &&
+                    (fwrite(&images[0], 1, images.size(), file) == images.size());
+    }
+    succeeded = (fclose(file) == 0) && succeeded;
+    if (!succeeded)
+    {
+        LOG_ERROR("Could not write %s", path.c_str());
+        return false;
+    }
+    LOG("Packed %zu ROMs into %s", entries.size(), path.c_str());
+    return true;
+}
+
+uint64_t RomPack::Hash(const uint8_t* data, uint32_t length)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+} /* namespace chip8 */
@@ -0,0 +1,114 @@
+#ifndef ROMPACK_H_
+#define ROMPACK_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace chip8
+{
+    /**
+     * A ROM inside a mapped RomPack.  The pointers stay valid until the
+     * pack is closed.
+     */
+    struct RomView
+    {
+        const char*     name;
+        const uint8_t*  data;
+        uint16_t        length;
+        uint64_t        hash;
+    };
+
+    /**
+     * Many ROMs in one file, mapped once so that finding a ROM is a lookup
+     * in the index instead of an open/read/close.
+     *
+     * Layout, little endian:
+     *   Header      magic "C8PK", version, entry count, reserved
+     *   Entry[n]    hash, offset, length, NUL padded name; sorted by name
+     *   Images      the ROMs back to back, at the offsets in the index
+     */
+    class RomPack
+    {
+    public:
+        static const uint32_t   MAGIC           = 0x4B503843;   // "C8PK"
+        static const uint32_t   VERSION         = 1;
+        static const uint32_t   NAME_LENGTH     = 48;           // Including the NUL
+        static const uint32_t   MAX_ROM_LENGTH  = 0xE00;
+
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t count;
+            uint32_t reserved;
+        };
+
+        struct Entry
+        {
+            uint64_t hash;
+            uint32_t offset;
+            uint32_t length;
+            char     name[NAME_LENGTH];
+        };
+
+        RomPack();
+        virtual ~RomPack();
+
+        /**
+         * Maps a pack file read only and checks its index
+         * @param path The pack file
+         * @return True if it is a valid pack
+         */
+        bool Open(const std::string& path);
+
+        /**
+         * Unmaps the pack.  Any RomView from it is invalid afterwards.
+         */
+        void Close();
+
+        uint32_t GetCount() const;
+
+        /**
+         * Returns a ROM by its position in the index
+         * @param index The position, less than GetCount()
+         * @param rom Filled in with the ROM
+         * @return True if index is in range
+         */
+        bool GetRom(uint32_t index, RomView& rom) const;
+
+        /**
+         * Finds a ROM by name with a binary search of the index
+         * @param name The name the ROM was packed under
+         * @param rom Filled in with the ROM
+         * @return True if it was found
+         */
+        bool Find(const std::string& name, RomView& rom) const;
+
+        /**
+         * Writes a pack from ROM files.  Each ROM is named after its file
+         * name without the directory.
+         * @param path The pack to create
+         * @param romPaths The ROM files
+         * @return True on success
+         */
+        static bool Create(const std::string& path, const std::vector<std::string>& romPaths);
+
+        /**
+         * 64 bit FNV-1a, the hash stored in the index
+         * @param data The bytes to hash
+         * @param length The number of bytes
+         * @return The hash
+         */
+        static uint64_t Hash(const uint8_t* data, uint32_t length);
+
+    protected:
+        const uint8_t*  _mapping;
+        size_t          _size;
+        const Header*   _header;
+        const Entry*    _entries;
+    };
+
+} /* namespace chip8 */
+
+#endif /* ROMPACK_H_ */
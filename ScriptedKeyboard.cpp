@@ -0,0 +1,84 @@
+#include "ScriptedKeyboard.h"
+
+namespace chip8
+{
+
+ScriptedKeyboard::ScriptedKeyboard()
+: _keyStates(0)
+, _waitCancelled(false)
+{
+}
+
+ScriptedKeyboard::~ScriptedKeyboard()
+{
+}
+
+bool ScriptedKeyboard::IsKeyDown(uint8_t key)
+{
+    if (key >= NUM_KEYS)
+    {
+        return false;
+    }
+    return (_keyStates.load(std::memory_order_relaxed) & (1 << key)) != 0;
+}
+
+uint8_t ScriptedKeyboard::GetKeyPress()
+{
+    std::lock_guard<std::mutex> lock(_queueLock);
+    if (_keyQueue.empty())
+    {
+        return NO_KEY;
+    }
+    uint8_t key = _keyQueue.front();
+    _keyQueue.pop_front();
+    return key;
+}
+
+void ScriptedKeyboard::BeginKeyWait()
+{
+}
+
+bool ScriptedKeyboard::WaitForKeyPress()
+{
+    std::unique_lock<std::mutex> lock(_queueLock);
+    while (_keyQueue.empty() && !_waitCancelled)
+    {
+        _queueCondition.wait(lock);
+    }
+    return !_waitCancelled;
+}
+
+void ScriptedKeyboard::CancelWait(bool cancelled)
+{
+    std::lock_guard<std::mutex> lock(_queueLock);
+    _waitCancelled = cancelled;
+    _queueCondition.notify_all();
+}
+
+void ScriptedKeyboard::SetKeyDown(uint8_t key, bool isDown)
+{
+    if (key >= NUM_KEYS)
+    {
+        return;
+    }
+    if (isDown)
+    {
+        _keyStates.fetch_or(1 << key);
+    }
+    else
+    {
+        _keyStates.fetch_and(~(1 << key));
+    }
+}
+
+void ScriptedKeyboard::PushKey(uint8_t key)
+{
+    if (key >= NUM_KEYS)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_queueLock);
+    _keyQueue.push_back(key);
+    _queueCondition.notify_all();
+}
+} /* namespace chip8 */
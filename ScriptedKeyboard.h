@@ -0,0 +1,66 @@
+#ifndef SCRIPTEDKEYBOARD_H_
+#define SCRIPTEDKEYBOARD_H_
+
+#include "Keyboard.h"
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace chip8
+{
+    /**
+     * Headless keyboard backend.  Key states and key presses are
+     * supplied by the host instead of a device.
+     */
+    class ScriptedKeyboard : public Keyboard
+    {
+    public:
+        ScriptedKeyboard();
+        virtual ~ScriptedKeyboard();
+
+        virtual bool IsKeyDown(uint8_t key);
+
+        /**
+         * Returns the next queued key press without blocking
+         * @return The next queued key, or NO_KEY if the queue is empty
+         */
+        virtual uint8_t GetKeyPress();
+
+        /**
+         * Keeps the queue; the script decides when presses happen
+         */
+        virtual void BeginKeyWait();
+
+        /**
+         * Blocks until a key press is queued
+         * @return False if the wait was cancelled
+         */
+        virtual bool WaitForKeyPress();
+        virtual void CancelWait(bool cancelled);
+
+        /**
+         * Sets whether a key is held down
+         * @param key The number of the key
+         * @param isDown True if the key is held down
+         */
+        void SetKeyDown(uint8_t key, bool isDown);
+
+        /**
+         * Queues a key press to be returned by GetKeyPress
+         * @param key The number of the key
+         */
+        void PushKey(uint8_t key);
+
+    protected:
+        std::atomic<uint16_t>   _keyStates;
+        std::mutex              _queueLock;
+        std::condition_variable _queueCondition;
+        std::deque<uint8_t>     _keyQueue;
+        bool                    _waitCancelled;
+    };
+
+} /* namespace chip8 */
+
+#endif /* SCRIPTEDKEYBOARD_H_ */
@@ -0,0 +1,132 @@
+#ifndef SPSCQUEUE_H_
+#define SPSCQUEUE_H_
+
+#include <stdint.h>
+#include <atomic>
+
+namespace chip8
+{
+    /**
+     * Bounded lock-free queue between exactly one producer thread and one
+     * consumer thread.  The indices run freely and wrap; SIZE must be a
+     * power of two.
+     */
+    template <typename T, uint32_t SIZE>
+    class SpscQueue
+    {
+        static_assert((SIZE & (SIZE - 1)) == 0, "SpscQueue size must be a power of two");
+
+    public:
+        SpscQueue() : _head(0), _tail(0), _consumerTail(0) {}
+
+        /**
+         * Adds an item.  Producer only.
+         * @param item The item
+         * @return False if the queue is full
+         */
+        bool Push(const T& item)
+        {
+            uint32_t head = _head.load(std::memory_order_relaxed);
+            if ((head - _tail.load(std::memory_order_acquire)) >= SIZE)
+            {
+                return false;
+            }
+            _items[head & (SIZE - 1)] = item;
+            _head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Removes the oldest item.  Consumer only.
+         * @param item Receives the item
+         * @return False if the queue is empty
+         */
+        bool Pop(T& item)
+        {
+            uint32_t tail = _consumerTail;
+            if (tail == _head.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            item = _items[tail & (SIZE - 1)];
+            _consumerTail = tail + 1;
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Adds as many items as fit.  Producer only.
+         * @param items The items
+         * @param count The number of items
+         * @return The number added
+         */
+        uint32_t Push(const T* items, uint32_t count)
+        {
+            uint32_t head = _head.load(std::memory_order_relaxed);
+            uint32_t space = SIZE - (head - _tail.load(std::memory_order_acquire));
+            if (count > space)
+            {
+                count = space;
+            }
+            for (uint32_t i = 0; i < count; i++)
+            {
+                _items[(head + i) & (SIZE - 1)] = items[i];
+            }
+            _head.store(head + count, std::memory_order_release);
+            return count;
+        }
+
+        /**
+         * Removes up to count of the oldest items.  Consumer only.
+         * @param items Receives the items
+         * @param count The most to remove
+         * @return The number removed
+         */
+        uint32_t Pop(T* items, uint32_t count)
+        {
+            uint32_t tail = _consumerTail;
+            uint32_t available = _head.load(std::memory_order_acquire) - tail;
+            if (count > available)
+            {
+                count = available;
+            }
+            for (uint32_t i = 0; i < count; i++)
+            {
+                items[i] = _items[(tail + i) & (SIZE - 1)];
+            }
+            _consumerTail = tail + count;
+            _tail.store(tail + count, std::memory_order_release);
+            return count;
+        }
+
+        /**
+         * Cheap check for the consumer's hot path, a single relaxed load.
+         * Consumer only.  Pop is still needed to see the item itself.
+         * @return True if an item may be waiting
+         */
+        bool HasItems() const
+        {
+            return _head.load(std::memory_order_relaxed) != _consumerTail;
+        }
+
+        /**
+         * Empties the queue.  Only call this while neither side is active.
+         */
+        void Clear()
+        {
+            _head.store(0, std::memory_order_relaxed);
+            _tail.store(0, std::memory_order_relaxed);
+            _consumerTail = 0;
+        }
+
+    protected:
+        // Each index on its own cache line, they are written by different threads
+        alignas(64) std::atomic<uint32_t>   _head;
+        alignas(64) std::atomic<uint32_t>   _tail;
+        uint32_t                            _consumerTail;  // The consumer's copy of _tail, never shared
+        alignas(64) T                       _items[SIZE];
+    };
+
+} /* namespace chip8 */
+
+#endif /* SPSCQUEUE_H_ */
@@ -0,0 +1,99 @@
+#include "StateFile.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LOG_TAG "StateFile"
+#include "log.h"
+
+namespace chip8
+{
+
+StateFile::StateFile()
+: _fd(-1)
+, _state(NULL)
+{
+}
+
+StateFile::~StateFile()
+{
+    Close();
+}
+
+bool StateFile::Open(const std::string& path, bool create)
+{
+    Close();
+
+    _fd = open(path.c_str(), create ? (O_RDWR | O_CREAT | O_CLOEXEC) : (O_RDWR | O_CLOEXEC), 0644);
+    if (_fd < 0)
+    {
+        LOG_ERROR("Could not open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(_fd, &info) != 0)
+    {
+        LOG_ERROR("Could not stat %s: %s", path.c_str(), strerror(errno));
+        Close();
+        return false;
+    }
+
+    if ((size_t)info.st_size != sizeof(Chip8State))
+    {
+        if (!create)
+        {
+            LOG_ERROR("%s is not a state file", path.c_str());
+            Close();
+            return false;
+        }
+        if (ftruncate(_fd, sizeof(Chip8State)) != 0)
+        {
+            LOG_ERROR("Could not size %s: %s", path.c_str(), strerror(errno));
+            Close();
+            return false;
+        }
+    }
+
+    void* mapping = mmap(NULL, sizeof(Chip8State), PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        LOG_ERROR("Could not map %s: %s", path.c_str(), strerror(errno));
+        Close();
+        return false;
+    }
+    _state = (Chip8State*)mapping;
+    return true;
+}
+
+void StateFile::Close()
+{
+    if (_state != NULL)
+    {
+        munmap(_state, sizeof(Chip8State));
+        _state = NULL;
+    }
+    if (_fd >= 0)
+    {
+        close(_fd);
+        _fd = -1;
+    }
+}
+
+Chip8State* StateFile::GetState()
+{
+    return _state;
+}
+
+bool StateFile::Sync()
+{
+    if (_state == NULL)
+    {
+        return false;
+    }
+    return (msync(_state, sizeof(Chip8State), MS_SYNC) == 0);
+}
+} /* namespace chip8 */
@@ -0,0 +1,52 @@
+#ifndef STATEFILE_H_
+#define STATEFILE_H_
+
+#include "Chip8State.h"
+#include <string>
+
+namespace chip8
+{
+    /**
+     * A Chip8State kept in a memory mapped file.  Saving into GetState()
+     * writes straight to the page cache, and loading after a restart maps
+     * the file and uses the struct in place with no parsing.
+     */
+    class StateFile
+    {
+    public:
+        StateFile();
+        virtual ~StateFile();
+
+        /**
+         * Maps a snapshot file
+         * @param path The file to map
+         * @param create True to create or resize the file if needed
+         * @return True if the file was mapped
+         */
+        bool Open(const std::string& path, bool create);
+
+        /**
+         * Unmaps the file
+         */
+        void Close();
+
+        /**
+         * Returns the mapped state
+         * @return The state, or NULL if no file is open
+         */
+        Chip8State* GetState();
+
+        /**
+         * Writes the mapped state back to disk and waits for it
+         * @return True on success
+         */
+        bool Sync();
+
+    protected:
+        int         _fd;
+        Chip8State* _state;
+    };
+
+} /* namespace chip8 */
+
+#endif /* STATEFILE_H_ */
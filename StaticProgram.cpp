@@ -0,0 +1,153 @@
+#include "StaticProgram.h"
+#include <string.h>
+
+#define LOG_TAG "StaticProgram"
+#include "log.h"
+
+namespace chip8
+{
+
+namespace
+{
+    // Zero initialised before any static constructor registers a ROM
+    StaticRom* registry = NULL;
+}
+
+void StaticProgram::Register(StaticRom& rom)
+{
+    rom.next = registry;
+    registry = &rom;
+}
+
+const StaticRom* StaticProgram::Find(uint64_t hash)
+{
+    for (const StaticRom* rom = registry; rom != NULL; rom = rom->next)
+    {
+        if (rom->hash == hash)
+        {
+            return rom;
+        }
+    }
+    return NULL;
+}
+
+StaticProgram::StaticProgram(const uint8_t* ram, uint16_t ramSize)
+: _ram(ram)
+, _ramSize(ramSize)
+, _rom(NULL)
+, _owners(ramSize / 2, -1)
+{
+}
+
+StaticProgram::~StaticProgram()
+{
+}
+
+void StaticProgram::Attach(const StaticRom* rom)
+{
+    _rom = rom;
+    _owners.assign(_ramSize / 2, -1);
+    _states.clear();
+    if (_rom == NULL)
+    {
+        return;
+    }
+
+    LOG("Running %s ahead-of-time compiled, %u blocks", _rom->name, _rom->blockCount);
+    _states.assign(_rom->blockCount, BLOCK_CHECK);
+    for (uint16_t i = 0; i < _rom->blockCount; i++)
+    {
+        const StaticBlock& block = _rom->blocks[i];
+        for (uint16_t n = 0; n < block.length; n++)
+        {
+            _owners[(block.address >> 1) + n] = i;
+        }
+    }
+}
+
+bool StaticProgram::IsAttached() const
+{
+    return (_rom != NULL);
+}
+
+uint32_t StaticProgram::Execute(Chip8Processor& cpu, uint32_t budget, bool& succeeded)
+{
+    StaticContext context(cpu);
+    uint32_t executed = 0;
+    while (executed < budget)
+    {
+        uint16_t pc = context.Pc();
+        if (((pc & 1) != 0) || (pc >= _ramSize))
+        {
+            break;
+        }
+        int16_t owner = _owners[pc >> 1];
+        if (owner < 0)
+        {
+            break;
+        }
+        const StaticBlock& block = _rom->blocks[owner];
+        if ((block.address != pc) || (block.length > budget - executed))
+        {
+            break;
+        }
+
+        if (_states[owner] != BLOCK_VALID)
+        {
+            if (_states[owner] == BLOCK_STALE)
+            {
+                break;
+            }
+            bool matches = (memcmp(_ram + pc, _rom->image + (pc - ORIGIN), block.length * 2) == 0);
+            if (!matches)
+            {
+                // Self-modifying code fails the check after every write;
+                // only the first time is worth a line
+                if (_states[owner] == BLOCK_CHECK)
+                {
+                    LOG("Block at 0x%x was modified, interpreting it", pc);
+                }
+                _states[owner] = BLOCK_STALE;
+                break;
+            }
+            _states[owner] = BLOCK_VALID;
+        }
+
+        if (!block.function(context))
+        {
+            // The block has already counted the instructions it ran
+            succeeded = false;
+            break;
+        }
+        executed += block.length;
+
+        // Hand loop back edges to the caller, which looks for idle loops
+        if (context.Pc() <= pc)
+        {
+            break;
+        }
+    }
+    return executed;
+}
+
+void StaticProgram::Invalidate(uint16_t address, uint16_t length)
+{
+    if (_rom == NULL)
+    {
+        return;
+    }
+    uint32_t end = (uint32_t)address + length;
+    if (end > _ramSize)
+    {
+        end = _ramSize;
+    }
+    for (uint32_t entry = (address >> 1); entry < ((end + 1) >> 1); entry++)
+    {
+        if (_owners[entry] >= 0)
+        {
+            uint8_t& state = _states[_owners[entry]];
+            state = ((state == BLOCK_STALE) || (state == BLOCK_RECHECK)) ? BLOCK_RECHECK : BLOCK_CHECK;
+        }
+    }
+}
+} /* namespace chip8 */
@@ -0,0 +1,155 @@
+#ifndef STATICPROGRAM_H_
+#define STATICPROGRAM_H_
+
+#include "Chip8Processor.h"
+#include <stdint.h>
+#include <vector>
+
+namespace chip8
+{
+    /**
+     * The view of a processor that code generated by aot/Chip8Aot gets.
+     * Register instructions are inlined in the generated blocks; every
+     * other instruction goes through the processor's own handler so it
+     * keeps the exact interpreter behaviour, including recording, replay
+     * and self-modification checks.
+     */
+    class StaticContext
+    {
+    public:
+        explicit StaticContext(Chip8Processor& cpu) : _cpu(cpu) {}
+
+        uint8_t* V() { return _cpu._v; }
+        uint16_t& I() { return _cpu._I; }
+        uint16_t Pc() const { return _cpu._pc; }
+
+        /**
+         * Brings the PC and the instruction count up to date, as Step would
+         * have left them, before a handler runs or a block exits
+         * @param pc The next PC
+         * @param count Instructions executed since the last Sync
+         */
+        void Sync(uint16_t pc, uint32_t count) { _cpu._pc = pc; _cpu._cycles += count; }
+
+        bool ClearScreen() { return _cpu.ClearScreen(); }
+        bool Return() { return _cpu.Return(); }
+        bool Call(uint16_t address) { return _cpu.Call(address); }
+        bool SetRandom(uint8_t x, uint8_t mask) { return _cpu.SetRandom(x, mask); }
+        bool DrawSprite(uint8_t x, uint8_t y, uint8_t size) { return _cpu.DrawSprite(x, y, size); }
+        bool SkipKeyPress(uint8_t x, bool ifIsPressed) { return _cpu.SkipKeyPress(x, ifIsPressed); }
+        bool StoreDelayTimer(uint8_t x) { return _cpu.StoreDelayTimer(x); }
+        bool WaitAndStoreKey(uint8_t x) { return _cpu.WaitAndStoreKey(x); }
+        bool SetDelayTimer(uint8_t x) { return _cpu.SetDelayTimer(x); }
+        bool SetSoundTimer(uint8_t x) { return _cpu.SetSoundTimer(x); }
+        bool StoreBCD(uint8_t x) { return _cpu.StoreBCD(x); }
+        bool StoreRegs(uint8_t x) { return _cpu.StoreRegs(x); }
+        bool FillRegs(uint8_t x) { return _cpu.FillRegs(x); }
+
+    protected:
+        Chip8Processor& _cpu;
+    };
+
+    typedef bool (*StaticBlockFunction)(StaticContext& context);
+
+    // A straight-line run of instructions compiled ahead of time
+    struct StaticBlock
+    {
+        uint16_t            address;
+        uint16_t            length;     // Instructions, every one is executed
+        StaticBlockFunction function;
+    };
+
+    // A ROM compiled ahead of time, emitted by aot/Chip8Aot
+    struct StaticRom
+    {
+        const char*         name;
+        uint64_t            hash;       // RomPack::Hash of the image
+        const uint8_t*      image;      // Loaded at ORIGIN
+        uint16_t            length;
+        const StaticBlock*  blocks;     // Sorted by address, never overlapping
+        uint16_t            blockCount;
+        StaticRom*          next;       // Registry link
+    };
+
+    /**
+     * Runs ahead-of-time compiled blocks for the loaded ROM.
+     *
+     * Compiled ROMs register themselves by hash when their translation
+     * unit is linked in.  A block only runs while the RAM under it still
+     * holds the bytes it was compiled from; a write to compiled code marks
+     * the blocks it hits for a recheck, and blocks that no longer match are
+     * left to the interpreter.  Addresses reached only through Bnnn or
+     * never found by the discovery pass have no block and are interpreted.
+     */
+    class StaticProgram
+    {
+    public:
+        static const uint16_t ORIGIN = 0x200;
+
+        /**
+         * Adds a compiled ROM to the registry.  Called from static
+         * initialisers in the generated code.
+         * @param rom The ROM, which must stay alive
+         */
+        static void Register(StaticRom& rom);
+
+        /**
+         * Looks up a compiled ROM
+         * @param hash The RomPack::Hash of the ROM
+         * @return The ROM or NULL if none is linked in
+         */
+        static const StaticRom* Find(uint64_t hash);
+
+        /**
+         * Constructor
+         * @param ram The processor memory
+         * @param ramSize The size of the processor memory in bytes
+         */
+        StaticProgram(const uint8_t* ram, uint16_t ramSize);
+        virtual ~StaticProgram();
+
+        /**
+         * Selects the compiled ROM to run
+         * @param rom The ROM, or NULL to interpret everything
+         */
+        void Attach(const StaticRom* rom);
+        bool IsAttached() const;
+
+        /**
+         * Runs compiled blocks from the current PC until the budget runs
+         * out, the PC has no usable block or a block jumps backwards
+         * @param cpu The processor
+         * @param budget The most instructions to execute
+         * @param succeeded Set to false if an instruction failed
+         * @return The number of instructions in the blocks that completed,
+         *         0 if the instruction at the PC must be run by the
+         *         interpreter.  A failed block is not included.
+         */
+        uint32_t Execute(Chip8Processor& cpu, uint32_t budget, bool& succeeded);
+
+        /**
+         * Marks compiled blocks for a recheck after a RAM write
+         * @param address The first byte written
+         * @param length The number of bytes written
+         */
+        void Invalidate(uint16_t address, uint16_t length);
+
+    protected:
+        enum BlockState
+        {
+            BLOCK_CHECK     = 0,    // RAM may differ from the image
+            BLOCK_VALID     = 1,
+            BLOCK_STALE     = 2,    // RAM differs, interpret until written again
+            BLOCK_RECHECK   = 3     // Was stale, RAM may differ from the image
+        };
+
+        const uint8_t*          _ram;
+        uint16_t                _ramSize;
+        const StaticRom*        _rom;
+        std::vector<int16_t>    _owners;    // Block covering each even address, -1 for none
+        std::vector<uint8_t>    _states;    // One per block
+    };
+
+} /* namespace chip8 */
+
+#endif /* STATICPROGRAM_H_ */
@@ -0,0 +1,90 @@
+#include "WavWriter.h"
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#define LOG_TAG "WavWriter"
+#include "log.h"
+
+namespace chip8
+{
+
+WavWriter::WavWriter()
+: _file(NULL)
+, _dataBytes(0)
+{
+}
+
+WavWriter::~WavWriter()
+{
+    Close();
+}
+
+bool WavWriter::Open(const std::string& path, uint32_t sampleRate)
+{
+    Close();
+    _file = (path == "-") ? stdout : fopen(path.c_str(), "wb");
+    if (_file == NULL)
+    {
+        LOG_ERROR("Could not create %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    _dataBytes = 0;
+
+    Header header =
+    {
+        { 'R', 'I', 'F', 'F' }, 0xFFFFFFFF, { 'W', 'A', 'V', 'E' },
+        { 'f', 'm', 't', ' ' }, 16, 1, 1, sampleRate, (uint32_t)(sampleRate * sizeof(int16_t)), sizeof(int16_t), 16,
+        { 'd', 'a', 't', 'a' }, 0xFFFFFFFF
+    };
+    fwrite(&header, sizeof(header), 1, _file);
+    return true;
+}
+
+bool WavWriter::Close()
+{
+    if (_file == NULL)
+    {
+        return true;
+    }
+
+    // A pipe cannot seek, so players read it until it ends
+    if ((_dataBytes <= 0xFFFFFFFF - sizeof(Header)) && (fseek(_file, 0, SEEK_SET) == 0))
+    {
+        uint32_t dataSize = (uint32_t)_dataBytes;
+        uint32_t riffSize = dataSize + sizeof(Header) - 8;
+        fseek(_file, offsetof(Header, riffSize), SEEK_SET);
+        fwrite(&riffSize, sizeof(riffSize), 1, _file);
+        fseek(_file, offsetof(Header, dataSize), SEEK_SET);
+        fwrite(&dataSize, sizeof(dataSize), 1, _file);
+    }
+
+    bool succeeded = (ferror(_file) == 0);
+    if (_file == stdout)
+    {
+        fflush(_file);
+    }
+    else
+    {
+        succeeded = (fclose(_file) == 0) && succeeded;
+    }
+    _file = NULL;
+    if (!succeeded)
+    {
+        LOG_ERROR("Could not write the WAV file");
+    }
+    return succeeded;
+}
+
+void WavWriter::Write(const int16_t* samples, uint32_t count)
+{
+    if (_file == NULL)
+    {
+        return;
+    }
+    // WAV is little-endian, like every host this runs on
+    fwrite(samples, sizeof(int16_t), count, _file);
+    _dataBytes += count * sizeof(int16_t);
+}
+
+} /* namespace chip8 */
@@ -0,0 +1,63 @@
+#ifndef WAVWRITER_H_
+#define WAVWRITER_H_
+
+#include "PcmSink.h"
+#include <stdio.h>
+#include <string>
+
+namespace chip8
+{
+    /**
+     * Writes samples to a mono 16-bit WAV file, or to stdout when the path
+     * is "-" so the stream can be piped straight into a player such as
+     * aplay; main then draws the screen on stderr instead.  The sizes in
+     * the header are filled in on Close when the file can seek, and left
+     * at their maximum for a pipe.
+     */
+    class WavWriter : public PcmSink
+    {
+    public:
+        struct Header
+        {
+            char     riff[4];
+            uint32_t riffSize;
+            char     wave[4];
+            char     fmt[4];
+            uint32_t fmtSize;
+            uint16_t format;
+            uint16_t channels;
+            uint32_t sampleRate;
+            uint32_t byteRate;
+            uint16_t blockAlign;
+            uint16_t bitsPerSample;
+            char     data[4];
+            uint32_t dataSize;
+        };
+
+        WavWriter();
+        virtual ~WavWriter();
+
+        /**
+         * Creates the file and writes the header
+         * @param path The file to create, or "-" for stdout
+         * @param sampleRate Samples per second
+         * @return False if the file could not be created
+         */
+        bool Open(const std::string& path, uint32_t sampleRate);
+
+        /**
+         * Fills in the header sizes and closes the file
+         * @return False if the file could not be written
+         */
+        bool Close();
+
+        virtual void Write(const int16_t* samples, uint32_t count);
+
+    protected:
+        FILE*       _file;
+        uint64_t    _dataBytes;
+    };
+
+} /* namespace chip8 */
+
+#endif /* WAVWRITER_H_ */
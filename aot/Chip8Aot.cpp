@@ -0,0 +1,548 @@
+/*
+ * Ahead-of-time compiler from a CHIP-8 ROM to a C++ translation unit.
+ *
+ *   chip8-aot rom output.cpp
+ *
+ * A discovery pass follows jumps, calls, returns and skips from the entry
+ * point to find the reachable instructions and splits them into blocks.
+ * Each block becomes one C++ function: register instructions are inlined
+ * with the interpreter's exact semantics, everything else calls the
+ * processor's handler through StaticContext.  Computed jumps (Bnnn) end a
+ * block and their targets are left to the interpreter, as is any block
+ * whose bytes are overwritten at run time.
+ *
+ * Add the output to the chip8 build; it registers itself by ROM hash and
+ * is picked up by Chip8Processor::EXEC_STATIC, which main selects when
+ * the loaded ROM has compiled code.
+ *
+ * Built by hand from this directory with:
+ *   g++ -std=c++0x -O2 -I.. -o chip8-aot Chip8Aot.cpp ../RomPack.cpp
+ */
+#include "RomPack.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <vector>
+
+#define LOG_TAG "Chip8Aot"
+#include "log.h"
+
+namespace
+{
+    const uint16_t ROM_OFFSET       = 0x200;
+    const uint16_t MAX_BLOCK_LENGTH = 16;   // Well under a frame's budget
+
+    enum Flow
+    {
+        FLOW_NEXT,          // Falls through to the next instruction
+        FLOW_HANDLER,       // Falls through, runs a processor handler
+        FLOW_END,           // Handler that may change what follows, ends the block
+        FLOW_JUMP,
+        FLOW_CALL,
+        FLOW_SKIP,
+        FLOW_EXIT,          // Return or computed jump, no static successor
+        FLOW_INVALID
+    };
+
+    class Compiler
+    {
+    public:
+        Compiler(const std::vector<uint8_t>& rom)
+        : _rom(rom)
+        , _end(ROM_OFFSET + rom.size())
+        , _reachable(0x1000, false)
+        {
+        }
+
+        void Discover()
+        {
+            std::vector<uint16_t> work;
+            work.push_back(ROM_OFFSET);
+            _leaders.insert(ROM_OFFSET);
+            while (!work.empty())
+            {
+                uint16_t address = work.back();
+                work.pop_back();
+                while (IsCode(address) && !_reachable[address])
+                {
+                    uint16_t instruction = Fetch(address);
+                    Flow flow = Classify(instruction);
+                    if (flow == FLOW_INVALID)
+                    {
+                        break;
+                    }
+                    _reachable[address] = true;
+
+                    uint16_t target = instruction & 0x0FFF;
+                    if ((flow == FLOW_JUMP) || (flow == FLOW_CALL))
+                    {
+                        AddLeader(target, work);
+                    }
+                    if ((flow == FLOW_CALL) || (flow == FLOW_END))
+                    {
+                        AddLeader(address + 2, work);
+                    }
+                    if (flow == FLOW_SKIP)
+                    {
+                        AddLeader(address + 2, work);
+                        AddLeader(address + 4, work);
+                    }
+                    if ((flow != FLOW_NEXT) && (flow != FLOW_HANDLER))
+                    {
+                        break;
+                    }
+                    address += 2;
+                }
+            }
+        }
+
+        void Split()
+        {
+            Block block = { 0, 0 };
+            for (uint32_t address = ROM_OFFSET; address < _end; address += 2)
+            {
+                if (!_reachable[address])
+                {
+                    Finish(block);
+                    continue;
+                }
+                if ((block.length > 0) && ((_leaders.count(address) != 0) || (block.length == MAX_BLOCK_LENGTH)))
+                {
+                    Finish(block);
+                }
+                if (block.length == 0)
+                {
+                    block.address = address;
+                }
+                block.length++;
+
+                Flow flow = Classify(Fetch(address));
+                if ((flow != FLOW_NEXT) && (flow != FLOW_HANDLER))
+                {
+                    Finish(block);
+                }
+            }
+            Finish(block);
+        }
+
+        bool Write(const char* path, const std::string& name)
+        {
+            FILE* out = fopen(path, "w");
+            if (out == NULL)
+            {
+                LOG_ERROR("Could not create %s", path);
+                return false;
+            }
+
+            std::string symbol = Symbol(name);
+            fprintf(out, "// Generated by chip8-aot from %s, do not edit\n", name.c_str());
+            fprintf(out, "#include \"StaticProgram.h\"\n\nnamespace\n{\n");
+            fprintf(out, "    const uint8_t image[] =\n    {");
+            for (size_t i = 0; i < _rom.size(); i++)
+            {
+                fprintf(out, "%s0x%02X,", ((i % 16) == 0) ? "\n        " : " ", _rom[i]);
+            }
+            fprintf(out, "\n    };\n");
+
+            for (size_t b = 0; b < _blocks.size(); b++)
+            {
+                WriteBlock(out, _blocks[b]);
+            }
+
+            fprintf(out, "\n    const chip8::StaticBlock blocks[] =\n    {\n");
+            for (size_t b = 0; b < _blocks.size(); b++)
+            {
+                fprintf(out, "        { 0x%03X, %u, &Block%03X },\n", _blocks[b].address, _blocks[b].length, _blocks[b].address);
+            }
+            fprintf(out, "    };\n\n");
+            fprintf(out, "    chip8::StaticRom rom = { \"%s\", 0x%016llXULL, image, %u, blocks, %u, NULL };\n",
+                    symbol.c_str(), (unsigned long long)chip8::RomPack::Hash(&_rom[0], _rom.size()),
+                    (unsigned)_rom.size(), (unsigned)_blocks.size());
+            fprintf(out, "\n    struct Registration\n    {\n        Registration() { chip8::StaticProgram::Register(rom); }\n    } registration;\n");
+            fprintf(out, "}\n");
+
+            bool succeeded = (ferror(out) == 0);
+            succeeded = (fclose(out) == 0) && succeeded;
+            LOG("%s: %zu blocks", path, _blocks.size());
+            return succeeded;
+        }
+
+    protected:
+        struct Block
+        {
+            uint16_t address;
+            uint16_t length;
+        };
+
+        bool IsCode(uint32_t address) const
+        {
+            return ((address & 1) == 0) && (address >= ROM_OFFSET) && (address + 1 < _end);
+        }
+
+        uint16_t Fetch(uint16_t address) const
+        {
+            return (_rom[address - ROM_OFFSET] << 8) | _rom[address - ROM_OFFSET + 1];
+        }
+
+        void AddLeader(uint16_t address, std::vector<uint16_t>& work)
+        {
+            if (IsCode(address))
+            {
+                _leaders.insert(address);
+                work.push_back(address);
+            }
+        }
+
+        void Finish(Block& block)
+        {
+            if (block.length > 0)
+            {
+                _blocks.push_back(block);
+            }
+            block.length = 0;
+        }
+
+        static Flow Classify(uint16_t instruction)
+        {
+            switch (instruction >> 12)
+            {
+                case 0x0:
+                {
+                    if (instruction == 0x00E0)
+                    {
+                        return FLOW_HANDLER;
+                    }
+                    return (instruction == 0x00EE) ? FLOW_EXIT : FLOW_INVALID;
+                }
+                case 0x1:
+                {
+                    return FLOW_JUMP;
+                }
+                case 0x2:
+                {
+                    return FLOW_CALL;
+                }
+                case 0x3:
+                case 0x4:
+                {
+                    return FLOW_SKIP;
+                }
+                case 0x5:
+                case 0x9:
+                {
+                    return ((instruction & 0x000F) == 0) ? FLOW_SKIP : FLOW_INVALID;
+                }
+                case 0x6:
+                case 0x7:
+                case 0xA:
+                {
+                    return FLOW_NEXT;
+                }
+                case 0x8:
+                {
+                    uint8_t code = instruction & 0x000F;
+                    return ((code <= 7) || (code == 14)) ? FLOW_NEXT : FLOW_INVALID;
+                }
+                case 0xB:
+                {
+                    return FLOW_EXIT;
+                }
+                case 0xC:
+                case 0xD:
+                {
+                    return FLOW_HANDLER;
+                }
+                case 0xE:
+                {
+                    uint16_t low = instruction & 0x00FF;
+                    return ((low == 0x9E) || (low == 0xA1)) ? FLOW_SKIP : FLOW_INVALID;
+                }
+                default:
+                {
+                    switch (instruction & 0x00FF)
+                    {
+                        case 0x1E:
+                        case 0x29:
+                        {
+                            return FLOW_NEXT;
+                        }
+                        case 0x07:
+                        case 0x15:
+                        case 0x18:
+                        case 0x65:
+                        {
+                            return FLOW_HANDLER;
+                        }
+                        case 0x0A:      // Blocks on the keyboard
+                        case 0x33:      // Stores may overwrite the code that follows
+                        case 0x55:
+                        {
+                            return FLOW_END;
+                        }
+                        default:
+                        {
+                            return FLOW_INVALID;
+                        }
+                    }
+                }
+            }
+        }
+
+        static std::string Symbol(const std::string& name)
+        {
+            std::string symbol = name.substr(name.find_last_of('/') + 1);
+            for (size_t i = 0; i < symbol.size(); i++)
+            {
+                if ((symbol[i] == '"') || (symbol[i] == '\\'))
+                {
+                    symbol[i] = '_';
+                }
+            }
+            return symbol;
+        }
+
+        void WriteBlock(FILE* out, const Block& block)
+        {
+            fprintf(out, "\n    bool Block%03X(chip8::StaticContext& context)\n    {\n", block.address);
+            fprintf(out, "        uint8_t* v = context.V();\n");
+            fprintf(out, "        uint16_t& I = context.I();\n");
+            fprintf(out, "        (void)v;\n        (void)I;\n");
+
+            uint32_t pending = 0;   // Instructions since the last Sync
+            for (uint16_t i = 0; i < block.length; i++)
+            {
+                uint16_t address = block.address + 2 * i;
+                uint16_t instruction = Fetch(address);
+                uint8_t x = (instruction >> 8) & 0xF;
+                uint8_t y = (instruction >> 4) & 0xF;
+                uint8_t kk = instruction & 0xFF;
+                uint16_t nnn = instruction & 0x0FFF;
+                pending++;
+
+                fprintf(out, "        // 0x%03X: %04X\n", address, instruction);
+                switch (instruction >> 12)
+                {
+                    case 0x0:
+                    {
+                        fprintf(out, "        context.Sync(0x%03X, %u);\n", address + 2, pending);
+                        if (instruction == 0x00E0)
+                        {
+                            fprintf(out, "        if (!context.ClearScreen())\n        {\n            return false;\n        }\n");
+                        }
+                        else
+                        {
+                            fprintf(out, "        return context.Return();\n");
+                        }
+                        pending = 0;
+                    }
+                    break;
+
+                    case 0x1:
+                    {
+                        fprintf(out, "        context.Sync(0x%03X, %u);\n        return true;\n", nnn, pending);
+                    }
+                    break;
+
+                    case 0x2:
+                    {
+                        fprintf(out, "        context.Sync(0x%03X, %u);\n        return context.Call(0x%03X);\n", address + 2, pending, nnn);
+                    }
+                    break;
+
+                    case 0x3:
+                    case 0x4:
+                    case 0x5:
+                    case 0x9:
+                    {
+                        const char* op = (((instruction >> 12) == 0x3) || ((instruction >> 12) == 0x5)) ? "==" : "!=";
+                        char right[16];
+                        if (((instruction >> 12) == 0x3) || ((instruction >> 12) == 0x4))
+                        {
+                            snprintf(right, sizeof(right), "0x%02X", kk);
+                        }
+                        else
+                        {
+                            snprintf(right, sizeof(right), "v[%u]", y);
+                        }
+                        fprintf(out, "        context.Sync((v[%u] %s %s) ? 0x%03X : 0x%03X, %u);\n        return true;\n",
+                                x, op, right, address + 4, address + 2, pending);
+                    }
+                    break;
+
+                    case 0x6:
+                    {
+                        fprintf(out, "        v[%u] = 0x%02X;\n", x, kk);
+                    }
+                    break;
+
+                    case 0x7:
+                    {
+                        fprintf(out, "        v[%u] += 0x%02X;\n", x, kk);
+                    }
+                    break;
+
+                    case 0x8:
+                    {
+                        WriteMath(out, x, y, instruction & 0xF);
+                    }
+                    break;
+
+                    case 0xA:
+                    {
+                        fprintf(out, "        I = 0x%03X;\n", nnn);
+                    }
+                    break;
+
+                    case 0xB:
+                    {
+                        fprintf(out, "        context.Sync(0x%03X + v[0], %u);\n        return true;\n", nnn, pending);
+                    }
+                    break;
+
+                    case 0xC:
+                    case 0xD:
+                    {
+                        fprintf(out, "        context.Sync(0x%03X, %u);\n", address + 2, pending);
+                        if ((instruction >> 12) == 0xC)
+                        {
+                            fprintf(out, "        if (!context.SetRandom(%u, 0x%02X))\n", x, kk);
+                        }
+                        else
+                        {
+                            fprintf(out, "        if (!context.DrawSprite(%u, %u, %u))\n", x, y, instruction & 0xF);
+                        }
+                        fprintf(out, "        {\n            return false;\n        }\n");
+                        pending = 0;
+                    }
+                    break;
+
+                    case 0xE:
+                    {
+                        fprintf(out, "        context.Sync(0x%03X, %u);\n        return context.SkipKeyPress(%u, %s);\n",
+                                address + 2, pending, x, (kk == 0x9E) ? "true" : "false");
+                    }
+                    break;
+
+                    default:
+                    {
+                        const char* handler = NULL;
+                        switch (kk)
+                        {
+                            case 0x1E:
+                            {
+                                fprintf(out, "        I = I + v[%u];\n", x);
+                            }
+                            break;
+
+                            case 0x29:
+                            {
+                                fprintf(out, "        I = 5 * v[%u];\n", x);
+                            }
+                            break;
+
+                            case 0x07: handler = "StoreDelayTimer"; break;
+                            case 0x0A: handler = "WaitAndStoreKey"; break;
+                            case 0x15: handler = "SetDelayTimer"; break;
+                            case 0x18: handler = "SetSoundTimer"; break;
+                            case 0x33: handler = "StoreBCD"; break;
+                            case 0x55: handler = "StoreRegs"; break;
+                            case 0x65: handler = "FillRegs"; break;
+                        }
+                        if (handler != NULL)
+                        {
+                            fprintf(out, "        context.Sync(0x%03X, %u);\n", address + 2, pending);
+                            if (Classify(instruction) == FLOW_END)
+                            {
+                                fprintf(out, "        return context.%s(%u);\n", handler, x);
+                            }
+                            else
+                            {
+                                fprintf(out, "        if (!context.%s(%u))\n        {\n            return false;\n        }\n", handler, x);
+                            }
+                            pending = 0;
+                        }
+                    }
+                    break;
+                }
+            }
+
+            // Blocks that did not end in a jump, call, skip or return fall through
+            Flow last = Classify(Fetch(block.address + 2 * (block.length - 1)));
+            if ((last == FLOW_NEXT) || (last == FLOW_HANDLER))
+            {
+                fprintf(out, "        context.Sync(0x%03X, %u);\n        return true;\n", block.address + 2 * block.length, pending);
+            }
+            fprintf(out, "    }\n");
+        }
+
+        // Keeps the statement order of Chip8Processor::Math, which matters when x or y is 15
+        static void WriteMath(FILE* out, uint8_t x, uint8_t y, uint8_t code)
+        {
+            switch (code)
+            {
+                case 0: fprintf(out, "        v[%u] = v[%u];\n", x, y); break;
+                case 1: fprintf(out, "        v[%u] |= v[%u];\n", x, y); break;
+                case 2: fprintf(out, "        v[%u] &= v[%u];\n", x, y); break;
+                case 3: fprintf(out, "        v[%u] ^= v[%u];\n", x, y); break;
+                case 4:
+                {
+                    fprintf(out, "        {\n            uint8_t oldX = v[%u];\n            v[%u] += v[%u];\n"
+                                 "            v[15] = (v[%u] < oldX);\n        }\n", x, x, y, x);
+                }
+                break;
+                case 5:
+                {
+                    fprintf(out, "        v[15] = (v[%u] > v[%u]) ? 1 : 0;\n        v[%u] = v[%u] - v[%u];\n", x, y, x, x, y);
+                }
+                break;
+                case 6:
+                {
+                    fprintf(out, "        v[15] = (v[%u] & 0x01) == 0 ? 0 : 1;\n        v[%u] >>= 1;\n", x, x);
+                }
+                break;
+                case 7:
+                {
+                    fprintf(out, "        v[15] = (v[%u] > v[%u]) ? 1 : 0;\n        v[%u] = v[%u] - v[%u];\n", y, x, x, y, x);
+                }
+                break;
+                case 14:
+                {
+                    fprintf(out, "        v[15] = (v[%u] & 0x80) == 0 ? 0 : 1;\n        v[%u] <<= 1;\n", x, x);
+                }
+                break;
+            }
+        }
+
+        const std::vector<uint8_t>& _rom;
+        uint32_t                    _end;
+        std::vector<bool>           _reachable;
+        std::set<uint16_t>          _leaders;
+        std::vector<Block>          _blocks;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        LOG_ERROR("Usage: chip8-aot rom output.cpp");
+        return 1;
+    }
+
+    std::ifstream file(argv[1], std::ifstream::binary);
+    std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (rom.empty() || (rom.size() > chip8::RomPack::MAX_ROM_LENGTH))
+    {
+        LOG_ERROR("%s is not a ROM", argv[1]);
+        return 1;
+    }
+
+    Compiler compiler(rom);
+    compiler.Discover();
+    compiler.Split();
+    return compiler.Write(argv[2], argv[1]) ? 0 : 1;
+}
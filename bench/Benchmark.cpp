@@ -0,0 +1,412 @@
+/*
+ * Throughput benchmarks for the interpreter, printed as JSON on stdout.
+ *
+ *   chip8-bench [--frames N] [--mode interpreter|predecoded|recompiler|static|all] [--batch LANES] [rom ...]
+ *
+ * Without ROM files it runs the opcode family microbenchmarks and the
+ * built-in synthetic ROMs.  With ROM files it runs each one end to end.
+ * Every run uses headless backends and turbo, and takes the best of
+ * RUN_COUNT repeats.  The microbenchmarks always run MICRO_FRAMES frames;
+ * --frames sets the length of the others.  A ROM gets a static row only
+ * when ahead-of-time code for it is linked in, and there is no recompiler
+ * row on hosts the recompiler does not support.  --batch adds a "batch" row
+ * per ROM that runs LANES copies in lockstep on one thread with
+ * BatchEngine; its instructions are summed over the lanes.
+ *
+ * Built by the Benchmark configuration in .cproject, or by hand from this
+ * directory with:
+ *   g++ -std=c++0x -O2 -DNDEBUG -I.. -o chip8-bench Benchmark.cpp \
+ *       $(find .. -maxdepth 1 -name '*.cpp' ! -name main.cpp) -lncurses -lpthread
+ */
+#include "Chip8Processor.h"
+#include "NullDisplay.h"
+#include "ScriptedKeyboard.h"
+#include "NullBeeper.h"
+#include "BatchEngine.h"
+#include "RomPack.h"
+#include "StaticProgram.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#define LOG_TAG "Benchmark"
+#include "log.h"
+
+namespace
+{
+    const uint16_t ROM_OFFSET               = 0x200;
+    const uint16_t MAX_ROM_SIZE             = 0xE00;
+    const uint32_t RUN_COUNT                = 3;
+    const uint32_t MICRO_FRAMES             = 2000;
+    const uint16_t MICRO_PER_FRAME          = 1000;
+    const uint32_t DEFAULT_FRAMES           = 20000;
+    const uint16_t REAL_PER_FRAME           = chip8::Chip8Processor::DEFAULT_INSTRUCTIONS_PER_FRAME;
+
+    struct Rom
+    {
+        const char*             name;
+        const char*             kind;       // "micro", "synthetic" or "file"
+        std::vector<uint8_t>    data;
+    };
+
+    struct Result
+    {
+        uint64_t    instructions;
+        uint64_t    idleInstructions;   // Included in instructions
+        uint32_t    frames;
+        double      seconds;
+        bool        succeeded;
+        bool        supported;          // False if the host cannot run the mode
+    };
+
+    struct BatchResult
+    {
+        chip8::BatchEngine::Stats   stats;
+        uint32_t                    frames;
+        bool                        succeeded;  // No lane halted
+    };
+
+    const char* const modeNames[] = { "interpreter", "predecoded", "recompiler", "static" };
+
+    void Append(std::vector<uint8_t>& rom, uint16_t instruction)
+    {
+        rom.push_back(instruction >> 8);
+        rom.push_back(instruction & 0xFF);
+    }
+
+    /**
+     * Builds setup, then body repeated, then a jump back to the first body
+     * instruction
+     */
+    std::vector<uint8_t> MakeLoop(const std::vector<uint16_t>& setup, const std::vector<uint16_t>& body, uint16_t repeat)
+    {
+        std::vector<uint8_t> rom;
+        for (size_t i = 0; i < setup.size(); i++)
+        {
+            Append(rom, setup[i]);
+        }
+        uint16_t loop = ROM_OFFSET + rom.size();
+        for (uint16_t r = 0; r < repeat; r++)
+        {
+            for (size_t i = 0; i < body.size(); i++)
+            {
+                Append(rom, body[i]);
+            }
+        }
+        Append(rom, 0x1000 | loop);
+        return rom;
+    }
+
+    std::vector<uint16_t> List(const uint16_t* instructions, size_t count)
+    {
+        return std::vector<uint16_t>(instructions, instructions + count);
+    }
+
+    void AddMicroRoms(std::vector<Rom>& roms)
+    {
+        // Math: every 8xyN form, VF included as an operand
+        const uint16_t mathSetup[] = { 0x6001, 0x6102, 0x6F03 };
+        const uint16_t mathBody[]  = { 0x8014, 0x8105, 0x8012, 0x8011, 0x8013, 0x8016, 0x801E, 0x8017, 0x8F14, 0x8010 };
+        Rom math = { "math", "micro", MakeLoop(List(mathSetup, 3), List(mathBody, 10), 40) };
+        roms.push_back(math);
+
+        // DrawSprite: full height sprites from the font area
+        const uint16_t drawSetup[] = { 0xA000, 0x6000, 0x6100 };
+        const uint16_t drawBody[]  = { 0xD01F, 0xD01F, 0xD105 };
+        Rom draw = { "draw", "micro", MakeLoop(List(drawSetup, 3), List(drawBody, 3), 100) };
+        roms.push_back(draw);
+
+        // StoreRegs / FillRegs of all 16 registers
+        const uint16_t regsSetup[] = { 0xA400 };
+        const uint16_t regsBody[]  = { 0xFF55, 0xFF65 };
+        Rom regs = { "regs", "micro", MakeLoop(List(regsSetup, 1), List(regsBody, 2), 100) };
+        roms.push_back(regs);
+
+        // StoreBCD
+        const uint16_t bcdSetup[]  = { 0xA400, 0x60FE };
+        const uint16_t bcdBody[]   = { 0xF033, 0x7001 };
+        Rom bcd = { "bcd", "micro", MakeLoop(List(bcdSetup, 2), List(bcdBody, 2), 100) };
+        roms.push_back(bcd);
+    }
+
+    void AddSyntheticRoms(std::vector<Rom>& roms)
+    {
+        // Tight loop: count V0 to 0xFF with a conditional branch
+        const uint16_t loopSetup[] = { 0x6000 };
+        const uint16_t loopBody[]  = { 0x7001, 0x8104, 0x30FF, 0x1202, 0x6000 };
+        Rom loop = { "tight-loop", "synthetic", MakeLoop(List(loopSetup, 1), List(loopBody, 5), 1) };
+        roms.push_back(loop);
+
+        // Sprite heavy: every hex digit across the screen, cleared each pass
+        const uint16_t spriteSetup[] = { 0x00E0, 0x6000, 0x6100, 0x6200 };
+        const uint16_t spriteBody[]  = { 0xF029, 0xD125, 0x7105, 0x7001, 0x4010, 0x6000, 0x4140, 0x7206, 0x4140, 0x6100 };
+        Rom sprites = { "sprite-heavy", "synthetic", MakeLoop(List(spriteSetup, 4), List(spriteBody, 10), 1) };
+        roms.push_back(sprites);
+
+        // Call heavy: nested subroutines that each do a little work
+        std::vector<uint8_t> calls;
+        const uint16_t callProgram[] =
+        {
+            0x2208,     // 200: call 208
+            0x2210,     // 202: call 210
+            0x7001,     // 204
+            0x1200,     // 206: loop
+            0x7101,     // 208
+            0x2210,     // 20A: call 210
+            0x00EE,     // 20C
+            0x0000,     // 20E
+            0x7201,     // 210
+            0x8324,     // 212
+            0x00EE,     // 214
+        };
+        for (size_t i = 0; i < sizeof(callProgram) / sizeof(callProgram[0]); i++)
+        {
+            Append(calls, callProgram[i]);
+        }
+        Rom callHeavy = { "call-heavy", "synthetic", calls };
+        roms.push_back(callHeavy);
+    }
+
+    bool ReadRom(const char* path, Rom& rom)
+    {
+        std::ifstream file(path, std::ifstream::binary);
+        if (!file)
+        {
+            LOG_ERROR("Could not open %s", path);
+            return false;
+        }
+        rom.name = path;
+        rom.kind = "file";
+        rom.data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        if (rom.data.empty() || (rom.data.size() > MAX_ROM_SIZE))
+        {
+            LOG_ERROR("%s is not a ROM", path);
+            return false;
+        }
+        return true;
+    }
+
+    Result RunOnce(const Rom& rom, chip8::Chip8Processor::ExecutionMode mode, uint32_t frames, uint16_t perFrame)
+    {
+        chip8::NullDisplay display;
+        chip8::ScriptedKeyboard keyboard;
+        chip8::NullBeeper beeper;
+        chip8::Chip8Processor processor(&keyboard, &display, &beeper);
+        processor.SetInstructionsPerFrame(perFrame);
+        processor.SetTurbo(true);
+        processor.LoadRom(&rom.data[0], rom.data.size());
+        processor.Reset();
+
+        Result result = { 0, 0, 0, 0, true, true };
+        if (!processor.SetExecutionMode(mode))
+        {
+            // Measuring the fallback under this mode's name would be wrong
+            result.supported = false;
+            return result;
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (; result.frames < frames; result.frames++)
+        {
+            if (!processor.RunFrame())
+            {
+                result.succeeded = false;
+                break;
+            }
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.instructions = processor.GetCycles();
+        result.idleInstructions = processor.GetIdleCycles();
+        return result;
+    }
+
+    BatchResult RunBatch(const Rom& rom, uint32_t lanes, uint32_t frames, uint16_t perFrame, const char*& kernel)
+    {
+        chip8::BatchEngine engine(lanes);
+        engine.LoadRom(&rom.data[0], rom.data.size());
+        engine.Reset();
+        kernel = engine.GetKernelName();
+
+        BatchResult result;
+        result.stats = engine.RunFrames(frames, perFrame);
+        result.frames = frames;
+        result.succeeded = true;
+        for (uint32_t lane = 0; lane < lanes; lane++)
+        {
+            if (engine.IsHalted(lane))
+            {
+                result.succeeded = false;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Prints text as a quoted JSON string, since ROM paths may hold quotes
+     * or backslashes
+     */
+    void PrintString(const char* text)
+    {
+        putchar('"');
+        for (const char* c = text; *c != '\0'; c++)
+        {
+            if ((*c == '"') || (*c == '\\'))
+            {
+                printf("\\%c", *c);
+            }
+            else if ((uint8_t)*c < 0x20)
+            {
+                printf("\\u%04x", (uint8_t)*c);
+            }
+            else
+            {
+                putchar(*c);
+            }
+        }
+        putchar('"');
+    }
+
+    void Report(const Rom& rom, const char* mode, const Result& result, bool& first)
+    {
+        double seconds = (result.seconds > 0) ? result.seconds : 1e-9;
+        printf("%s\n    {\"name\": ", first ? "" : ",");
+        PrintString(rom.name);
+        printf(", \"kind\": \"%s\", \"mode\": \"%s\", \"succeeded\": %s, "
+               "\"instructions\": %llu, \"idle_instructions\": %llu, \"frames\": %u, \"seconds\": %.6f, "
+               "\"instructions_per_second\": %.0f, \"frames_per_second\": %.1f}",
+               rom.kind, mode, result.succeeded ? "true" : "false",
+               (unsigned long long)result.instructions, (unsigned long long)result.idleInstructions, result.frames, result.seconds,
+               result.instructions / seconds, result.frames / seconds);
+        first = false;
+    }
+
+    void ReportBatch(const Rom& rom, uint32_t lanes, const char* kernel, const BatchResult& result, bool& first)
+    {
+        printf("%s\n    {\"name\": ", first ? "" : ",");
+        PrintString(rom.name);
+        printf(", \"kind\": \"%s\", \"mode\": \"batch\", \"lanes\": %u, \"kernel\": \"%s\", \"succeeded\": %s, "
+               "\"instructions\": %llu, \"vector_steps\": %llu, \"scalar_steps\": %llu, \"frames\": %u, \"seconds\": %.6f, "
+               "\"instructions_per_second\": %.0f}",
+               rom.kind, lanes, kernel, result.succeeded ? "true" : "false",
+               (unsigned long long)result.stats.instructions, (unsigned long long)result.stats.vectorSteps,
+               (unsigned long long)result.stats.scalarSteps, result.frames, result.stats.seconds,
+               result.stats.InstructionsPerSecond());
+        first = false;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t frames = DEFAULT_FRAMES;
+    int firstMode = chip8::Chip8Processor::EXEC_INTERPRETER;
+    int lastMode = chip8::Chip8Processor::EXEC_STATIC;
+    uint32_t batchLanes = 0;
+    std::vector<Rom> roms;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--frames") == 0) && (i + 1 < argc))
+        {
+            frames = strtoul(argv[++i], NULL, 0);
+        }
+        else if ((strcmp(argv[i], "--batch") == 0) && (i + 1 < argc))
+        {
+            batchLanes = strtoul(argv[++i], NULL, 0);
+        }
+        else if ((strcmp(argv[i], "--mode") == 0) && (i + 1 < argc))
+        {
+            const char* name = argv[++i];
+            if (strcmp(name, "all") != 0)
+            {
+                int found = -1;
+                for (int mode = 0; mode <= chip8::Chip8Processor::EXEC_STATIC; mode++)
+                {
+                    if (strcmp(name, modeNames[mode]) == 0)
+                    {
+                        found = mode;
+                    }
+                }
+                if (found < 0)
+                {
+                    LOG_ERROR("Unknown mode %s", name);
+                    return 1;
+                }
+                firstMode = lastMode = found;
+            }
+        }
+        else
+        {
+            Rom rom;
+            if (!ReadRom(argv[i], rom))
+            {
+                return 1;
+            }
+            roms.push_back(rom);
+        }
+    }
+
+    bool realRoms = !roms.empty();
+    if (!realRoms)
+    {
+        AddMicroRoms(roms);
+        AddSyntheticRoms(roms);
+    }
+
+    printf("{\"benchmark\": \"chip8\", \"version\": 1, \"results\": [");
+    bool first = true;
+    for (size_t r = 0; r < roms.size(); r++)
+    {
+        bool micro = (strcmp(roms[r].kind, "micro") == 0);
+        uint64_t hash = chip8::RomPack::Hash(&roms[r].data[0], roms[r].data.size());
+        for (int mode = firstMode; mode <= lastMode; mode++)
+        {
+            // Without its compiled code a ROM would only run predecoded again
+            if ((mode == chip8::Chip8Processor::EXEC_STATIC) && (chip8::StaticProgram::Find(hash) == NULL))
+            {
+                continue;
+            }
+            Result best = { 0, 0, 0, 0, false, true };
+            for (uint32_t run = 0; run < RUN_COUNT; run++)
+            {
+                Result result = RunOnce(roms[r], (chip8::Chip8Processor::ExecutionMode)mode,
+                                        micro ? MICRO_FRAMES : frames,
+                                        realRoms ? REAL_PER_FRAME : MICRO_PER_FRAME);
+                if (!result.supported)
+                {
+                    best = result;
+                    break;
+                }
+                if ((run == 0) || (result.seconds < best.seconds))
+                {
+                    best = result;
+                }
+            }
+            if (best.supported)
+            {
+                Report(roms[r], modeNames[mode], best, first);
+            }
+        }
+
+        if (batchLanes > 0)
+        {
+            const char* kernel = "";
+            BatchResult best;
+            for (uint32_t run = 0; run < RUN_COUNT; run++)
+            {
+                BatchResult result = RunBatch(roms[r], batchLanes, micro ? MICRO_FRAMES : frames,
+                                              realRoms ? REAL_PER_FRAME : MICRO_PER_FRAME, kernel);
+                if ((run == 0) || (result.stats.seconds < best.stats.seconds))
+                {
+                    best = result;
+                }
+            }
+            ReportBatch(roms[r], batchLanes, kernel, best, first);
+        }
+    }
+    printf("\n]}\n");
+    return 0;
+}
@@ -6,7 +6,40 @@
 #include <thread>
 #include <functional>
 
-#define LOG(...) { \
+/*
+ * Log levels.  Build with -DCHIP8_LOG_LEVEL=<n> to choose how much logging
+ * is compiled in; every macro above the chosen level expands to nothing.
+ *
+ *   LOG_ERROR  - failures
+ *   LOG        - lifecycle messages (default for debug builds)
+ *   LOG_DEBUG  - diagnostic detail
+ *   LOG_TRACE  - per instruction tracing; LOG_RED is the red variant
+ *
+ * At LOG_LEVEL_TRACE all records go through AsyncLog so the execution
+ * thread never blocks on stderr.
+ */
+#define LOG_LEVEL_NONE      0
+#define LOG_LEVEL_ERROR     1
+#define LOG_LEVEL_INFO      2
+#define LOG_LEVEL_DEBUG     3
+#define LOG_LEVEL_TRACE     4
+
+#ifndef CHIP8_LOG_LEVEL
+#ifdef NDEBUG
+#define CHIP8_LOG_LEVEL LOG_LEVEL_ERROR
+#else
+#define CHIP8_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+#endif
+
+#if CHIP8_LOG_LEVEL >= LOG_LEVEL_TRACE
+#include "AsyncLog.h"
+
+#define LOG_WRITE(isRed, ...) { \
+  ::chip8::AsyncLog::Write(isRed, LOG_TAG, __VA_ARGS__); \
+}
+#else
+#define LOG_WRITE(isRed, ...) { \
   timeval curTime; \
   gettimeofday(&curTime, NULL); \
   int milli = curTime.tv_usec / 1000; \
@@ -14,14 +47,38 @@
   strftime(buffer, 80, "%Y-%m-%d %H:%M:%S", localtime(&curTime.tv_sec)); \
   std::thread::id tid = std::this_thread::get_id(); \
   std::hash<std::thread::id> idHash; \
+  if (isRed) fprintf(stderr, "\033[0;31m"); \
   fprintf(stderr, "%s.%d (%03d) - %s: ", buffer, milli, (uint8_t)idHash(tid), LOG_TAG); \
   fprintf(stderr, __VA_ARGS__); \
   fprintf(stderr, "\n"); \
+  if (isRed) fprintf(stderr, "\033[0m"); \
 }
+#endif
+
+#if CHIP8_LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...)  LOG_WRITE(false, __VA_ARGS__)
+#else
+#define LOG_ERROR(...)  {}
+#endif
+
+#if CHIP8_LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG(...)        LOG_WRITE(false, __VA_ARGS__)
+#else
+#define LOG(...)        {}
+#endif
+
+#if CHIP8_LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...)  LOG_WRITE(false, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...)  {}
+#endif
+
+#if CHIP8_LOG_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE(...)  LOG_WRITE(false, __VA_ARGS__)
+#define LOG_RED(...)    LOG_WRITE(true, __VA_ARGS__)
+#else
+#define LOG_TRACE(...)  {}
+#define LOG_RED(...)    {}
+#endif
 
-#define LOG_RED(...) { \
-   fprintf(stderr, "\033[0;31m"); \
-   LOG(__VA_ARGS__); \
-   fprintf(stderr, "\033[0m"); \
-}
 #endif /* LOG_H_ */
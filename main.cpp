@@ -1,42 +1,316 @@
 #include "Chip8Processor.h"
-#include "Keyboard.h"
-#include "Display.h"
-#include "Beeper.h"
+#include "EvdevKeyboard.h"
+#include "CursesDisplay.h"
+#include "CursesBeeper.h"
+#include "PcmBeeper.h"
+#include "WavWriter.h"
+#include "InputRecorder.h"
+#include "InputReplayer.h"
+#include "Profiler.h"
+#include "FrameCapture.h"
+#include "RomPack.h"
+#include "StaticProgram.h"
+#include "RegressionRunner.h"
 #include <iostream>
 #include <fstream>
+#include <iterator>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
 
 
 #define LOG_TAG "main"
 #include "log.h"
 
+namespace
+{
+    volatile sig_atomic_t interrupted = 0;
+
+    void OnInterrupt(int)
+    {
+        interrupted = 1;
+    }
+
+    // Runs every ROM headless and prints or checks their hashes.  Returns
+    // the exit code: 0 when everything ran and matched.
+    int RunRegression(uint32_t frames, bool printHashes, const char* goldenPath,
+            const char* packPath, const std::vector<std::string>& positional)
+    {
+        chip8::RegressionRunner runner(frames);
+        chip8::RomPack pack;
+        bool added = true;
+        if (packPath != NULL)
+        {
+            if (!pack.Open(packPath))
+            {
+                return -1;
+            }
+            // Named ROMs from the pack, or all of them
+            chip8::RomView rom;
+            for (size_t i = 0; i < positional.size(); i++)
+            {
+                if (!pack.Find(positional[i], rom))
+                {
+                    LOG_ERROR("%s is not in %s", positional[i].c_str(), packPath);
+                    added = false;
+                    continue;
+                }
+                runner.AddRom(rom);
+            }
+            for (uint32_t i = 0; positional.empty() && (i < pack.GetCount()); i++)
+            {
+                pack.GetRom(i, rom);
+                runner.AddRom(rom);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < positional.size(); i++)
+            {
+                added = runner.AddPath(positional[i]) && added;
+            }
+        }
+
+        runner.Run();
+        if (printHashes)
+        {
+            runner.Write(stdout);
+        }
+
+        // With a golden file a failed instruction is only an error if it is
+        // new, and then the cycle count in the hash gives it away
+        bool succeeded = added;
+        const std::vector<chip8::RegressionRunner::Result>& results = runner.GetResults();
+        if (goldenPath != NULL)
+        {
+            int mismatches = runner.Compare(goldenPath, stderr);
+            fprintf(stderr, "%zu ROMs, %d mismatches\n", results.size(), mismatches);
+            succeeded = succeeded && (mismatches == 0);
+        }
+        else
+        {
+            for (size_t i = 0; i < results.size(); i++)
+            {
+                succeeded = succeeded && results[i].succeeded;
+            }
+        }
+        return succeeded ? 0 : 1;
+    }
+}
+
 int main(int argc, char* argv[])
 {
-    if (argc != 2)
+    // chip8 [--record file] [--replay file] [--profile report] [--capture file] [--audio file.wav] [--pack file] rom [keyboard device]
+    // chip8 --make-pack file rom...
+    // chip8 --frames N [--hash] [--golden file] [--pack file] rom|directory...
+    const char* keyboardPath = chip8::EvdevKeyboard::DEFAULT_DEVICE;
+    const char* recordPath = NULL;
+    const char* replayPath = NULL;
+    const char* profilePath = NULL;
+    const char* capturePath = NULL;
+    const char* audioPath = NULL;
+    const char* packPath = NULL;
+    const char* newPackPath = NULL;
+    const char* goldenPath = NULL;
+    uint32_t frames = 0;
+    bool printHashes = false;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--record") == 0) && (i + 1 < argc))
+        {
+            recordPath = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--replay") == 0) && (i + 1 < argc))
+        {
+            replayPath = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--profile") == 0) && (i + 1 < argc))
+        {
+            profilePath = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--capture") == 0) && (i + 1 < argc))
+        {
+            capturePath = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--audio") == 0) && (i + 1 < argc))
+        {
+            audioPath = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--pack") == 0) && (i + 1 < argc))
+        {
+            packPath = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--make-pack") == 0) && (i + 1 < argc))
+        {
+            newPackPath = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--frames") == 0) && (i + 1 < argc))
+        {
+            frames = strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--hash") == 0)
+        {
+            printHashes = true;
+        }
+        else if ((strcmp(argv[i], "--golden") == 0) && (i + 1 < argc))
+        {
+            goldenPath = argv[++i];
+        }
+        else
+        {
+            positional.push_back(argv[i]);
+        }
+    }
+
+    if (newPackPath != NULL)
+    {
+        return chip8::RomPack::Create(newPackPath, positional) ? 0 : -1;
+    }
+
+    if (frames > 0)
+    {
+        return RunRegression(frames, printHashes, goldenPath, packPath, positional);
+    }
+
+    if (positional.empty())
     {
-        LOG("You must specify a file!");
+        LOG_ERROR("You must specify a file!");
         exit(-1);
     }
-    char* romPath = argv[1];
+    const char* romPath = positional[0].c_str();
+    if (positional.size() > 1)
+    {
+        keyboardPath = positional[1].c_str();
+    }
+
+    // Find the ROM before the terminal is taken over, so errors are readable
     LOG("Loading %s", romPath);
-    chip8::Display* disp = new chip8::Display();
+    chip8::RomPack pack;
+    chip8::RomView rom;
+    std::vector<uint8_t> romData;
+    if (packPath != NULL)
+    {
+        if (!pack.Open(packPath) || !pack.Find(romPath, rom))
+        {
+            LOG_ERROR("%s is not in %s", romPath, packPath);
+            exit(-1);
+        }
+    }
+    else
+    {
+        std::ifstream romFile(romPath, std::ifstream::binary);
+        romData.assign(std::istreambuf_iterator<char>(romFile), std::istreambuf_iterator<char>());
+        if (romData.empty() || (romData.size() > chip8::RomPack::MAX_ROM_LENGTH))
+        {
+            LOG_ERROR("%s is not a ROM: %zu bytes", romPath, romData.size());
+            exit(-1);
+        }
+        rom.name = romPath;
+        rom.data = &romData[0];
+        rom.length = romData.size();
+        rom.hash = chip8::RomPack::Hash(rom.data, rom.length);
+    }
+
+    // Sound goes to the terminal bell, or is synthesized into a WAV file
+    chip8::WavWriter* wav = NULL;
+    if (audioPath != NULL)
+    {
+        wav = new chip8::WavWriter();
+        if (!wav->Open(audioPath, chip8::PcmBeeper::DEFAULT_SAMPLE_RATE))
+        {
+            exit(-1);
+        }
+    }
+
+    // A WAV stream on stdout moves the screen to stderr
+    bool audioToStdout = (audioPath != NULL) && (strcmp(audioPath, "-") == 0);
+    chip8::Display* disp = new chip8::CursesDisplay(audioToStdout ? stderr : stdout);
     LOG("Creating keyboard");
-    chip8::Keyboard* kb = new chip8::Keyboard();
+    chip8::Keyboard* kb = new chip8::EvdevKeyboard(keyboardPath);
     LOG("Creating beeper");
-    chip8::Beeper* beeper = new chip8::Beeper();
+    chip8::Beeper* beeper = NULL;
+    if (wav != NULL)
+    {
+        beeper = new chip8::PcmBeeper(wav);
+    }
+    else
+    {
+        beeper = new chip8::CursesBeeper();
+    }
     LOG("Creating processor");
     chip8::Chip8Processor* proc = new chip8::Chip8Processor(kb, disp, beeper);
 
-    std::ifstream romFile(romPath, std::ifstream::binary);
-    uint8_t buffer[3584] = {0};  // Max file size
-    romFile.read((char*)buffer, 3584);
+    chip8::InputRecorder* recorder = NULL;
+    if (recordPath != NULL)
+    {
+        recorder = new chip8::InputRecorder();
+        if (!recorder->Open(recordPath))
+        {
+            exit(-1);
+        }
+        proc->SetInputRecorder(recorder);
+    }
+    chip8::InputReplayer* replayer = NULL;
+    if (replayPath != NULL)
+    {
+        replayer = new chip8::InputReplayer();
+        if (!replayer->Open(replayPath))
+        {
+            exit(-1);
+        }
+        proc->SetInputReplayer(replayer);
+    }
+
+    chip8::Profiler* profiler = NULL;
+    if (profilePath != NULL)
+    {
+        profiler = new chip8::Profiler();
+        proc->SetProfiler(profiler);
+    }
+
+    chip8::FrameCapture* capture = NULL;
+    if (capturePath != NULL)
+    {
+        capture = new chip8::FrameCapture();
+        if (!capture->Open(capturePath))
+        {
+            exit(-1);
+        }
+        proc->SetFrameSink(capture);
+    }
+
     LOG("Loading rom");
-    proc->LoadRom(buffer, 3584);
+    proc->LoadRom(rom);
+    if (chip8::StaticProgram::Find(rom.hash) != NULL)
+    {
+        proc->SetExecutionMode(chip8::Chip8Processor::EXEC_STATIC);
+    }
     LOG("Resetting processor");
     proc->Reset();
     LOG("Run!");
+    signal(SIGINT, OnInterrupt);
     proc->Run();
-    while (proc->IsRunning())
+    while (proc->IsRunning() && !interrupted)
+    {
+       std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    proc->Stop();
+    LOG("%llu instructions, %llu skipped in idle loops",
+        (unsigned long long)proc->GetCycles(), (unsigned long long)proc->GetIdleCycles());
+
+    if (profiler != NULL)
     {
-       std::this_thread::sleep_for(std::chrono::seconds(1));
+        profiler->WriteReport(profilePath);
     }
+    delete recorder;    // Writes out the end of the recording
+    delete replayer;
+    delete capture;     // Writes the keyframe index
+    delete profiler;
+    delete proc;
+    delete beeper;
+    delete wav;         // Fills in the WAV header
+    delete kb;
+    delete disp;        // Restores the terminal
 }